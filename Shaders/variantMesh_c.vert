@@ -16,9 +16,10 @@ layout(location = 4) flat out uint drawID;
 
 uniform mat4 view;
 uniform mat4 proj;
+uniform int drawsPerVariant; // draw commands per variant, one for each level of detail
 
 void main() {
-  drawID = uint(gl_DrawID); // to count variants
+  drawID = uint(gl_DrawID / max(drawsPerVariant, 1)); // to count variants
   vec4 totalPos = vec4(vertex_position, 1.0);
   FragPos = vec3(instance_trans * vec4(vertex_position, 1.0));
   Normal = mat3(transpose(inverse(instance_trans))) * vertex_normal;
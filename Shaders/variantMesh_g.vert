@@ -31,19 +31,57 @@ layout (std430, binding = 2) buffer readonly BoneOffsets {
     int boffsets[];
 };
 
+// compact instance transform. must match InstanceS
+struct Instance {
+  vec4 posScale;  // xyz is the position, w the uniform scale
+  vec4 rotation;  // orientation quaternion
+};
+
 layout (std430, binding = 6) buffer readonly BTransforms {
-    mat4 instance_trans[];
+    Instance instance_trans[];
+};
+
+// transforms from the step before `instance_trans`
+layout (std430, binding = 14) buffer readonly BPrevTransforms {
+    Instance prev_instance_trans[];
+};
+
+// ids of the instances that passed cull.comp, packed at the start of each variant's range
+layout (std430, binding = 17) buffer readonly VisibleInstances {
+    uint visibleInstances[];
+};
+
+// texture depth of each instance. read by id, since `texture_depth` follows the draw order rather than the instance
+layout (std430, binding = 19) buffer readonly InstanceDepths {
+    float instanceDepths[];
 };
 
 uniform mat4 view;
 uniform mat4 proj;
+uniform int drawsPerVariant; // draw commands per variant, one for each level of detail
+uniform float transformAlpha; // how far to blend from `prev_instance_trans` to `instance_trans`
+
+// Rotate `v` by the unit quaternion `q`
+vec3 rotate(vec4 q, vec3 v) {
+  return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// transpose(inverse(m)), from the cofactors of `m`. anim.comp interpolates scaling keys, so bones can scale non-uniformly
+// and their normals need the full inverse transpose, but this is far cheaper per vertex than `inverse`
+mat3 inverseTranspose(mat3 m) {
+  return mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1])) / dot(m[0], cross(m[1], m[2]));
+}
 
 void main() {
-  drawID = uint(gl_DrawID); // to count variants
-  uint iid = uint(gl_BaseInstance + gl_InstanceID); // instance id
+  drawID = uint(gl_DrawID / max(drawsPerVariant, 1)); // to count variants
+  uint iid = visibleInstances[gl_BaseInstance + gl_InstanceID]; // instance id
+  Instance prev = prev_instance_trans[iid];
+  Instance next = instance_trans[iid];
+  vec4 posScale = mix(prev.posScale, next.posScale, transformAlpha);
+  vec4 rotation = normalize(mix(prev.rotation, dot(prev.rotation, next.rotation) < 0.0 ? -next.rotation : next.rotation, transformAlpha));
   // drawID = uint(gl_BaseInstance + gl_InstanceID); // to count instances
 
-  vec4 totalPos = vec4(0.0);
+  vec3 totalPos = vec3(0.0);
   vec3 totalNormal = vec3(0.0);
   int cnt = 0; // number of bones
   for (int i = 0; i < 4; i++) {
@@ -51,23 +89,20 @@ void main() {
       continue;
     cnt++;
     mat4 bone = infos[bone_ids[i] + boffsets[drawID]].currentTransformation;
-    totalPos += bone_weights[i] * bone * vec4(vertex_position, 1.0);
-
-    vec3 worldNormal = mat3(transpose(inverse(bone))) * vertex_normal;
-    totalNormal += worldNormal * bone_weights[i];
+    totalPos += bone_weights[i] * vec3(bone * vec4(vertex_position, 1.0));
+    totalNormal += bone_weights[i] * (inverseTranspose(mat3(bone)) * vertex_normal);
   }
 
   if (cnt == 0) {
     // if no bones, animate as if it's static
-    totalPos = vec4(vertex_position, 1.0);
-    FragPos = vec3(instance_trans[iid] * vec4(vertex_position, 1.0));
-    Normal = mat3(transpose(inverse(instance_trans[iid]))) * vertex_normal;
-  } else {
-    FragPos = vec3(instance_trans[iid] * totalPos);
-    Normal = vec3(normalize(instance_trans[iid] * vec4(totalNormal, 0.0)));
+    totalPos = vertex_position;
+    totalNormal = vertex_normal;
   }
 
+  // instances are only ever scaled uniformly, so normals just need rotating
+  FragPos = posScale.xyz + rotate(rotation, totalPos * posScale.w);
+  Normal = normalize(rotate(rotation, totalNormal));
   TexCoords = vertex_texture;
-  tDepth = texture_depth;
-  gl_Position = proj * view * instance_trans[iid] * totalPos;
+  tDepth = instanceDepths[iid];
+  gl_Position = proj * view * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,183 @@
+// Headless flock benchmark. Runs the cpu simulation with no window, GL context or ImGui, so simulation throughput can be
+// measured on its own (and on any machine). Built with HEADLESS defined, which also forces the cpu path (TREE).
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "flock.h"
+
+struct BenchOptions {
+    int perType = 500;                // boids of each type, unless overridden by --count
+    int counts[NUM_BOID_TYPES] = {};  // -1 uses `perType`
+    int steps = 500;
+    int warmup = 50;
+    int threads = 0;  // 0 uses every hardware thread
+    int homes = 16;
+    bool floor = false;  // bake a floor for the boids to avoid
+    float floorHeight = 0;
+    unsigned seed = 1;
+    bool useGrid = true;
+    bool neighbourLists = false;
+    bool simd = false;
+    bool reorder = true;
+    bool topological = false;
+    bool splitTypes = true;
+};
+
+static void printUsage(const char* exe) {
+    printf("usage: %s [options]\n", exe);
+    printf("  -n, --per-type N     boids of each type (default 500)\n");
+    printf("  --count TYPE=N       boids of a single type, by index. can be repeated\n");
+    printf("  -s, --steps N        measured steps (default 500)\n");
+    printf("  -w, --warmup N       steps run before measuring (default 50)\n");
+    printf("  -t, --threads N      worker threads, including the main thread (default: all)\n");
+    printf("  --seed N             random seed for the starting positions (default 1)\n");
+    printf("  --homes N            homes scattered over the level floor (default 16)\n");
+    printf("  --floor Y            steer the boids away from a floor at height Y\n");
+    printf("  --octree             search the octree instead of the grid\n");
+    printf("  --topological        only flock with the nearest boids (octree only)\n");
+    printf("  --lists              reuse neighbour lists between steps\n");
+    printf("  --simd               use the AVX2 kernel when the CPU has it\n");
+    printf("  --no-simd            always use the scalar kernel (default)\n");
+    printf("  --no-reorder         never sort boids into spatial order\n");
+    printf("  --no-split           search every type at once in the grid, instead of family then predators/prey\n");
+    printf("types:\n");
+    for (int t = 0; t < NUM_BOID_TYPES; ++t) printf("  %2d %s\n", t, BoidInfo::getBoidName((BoidType)t).c_str());
+}
+
+// Read the options into `opt`. Returns false if the program should exit
+static bool parseArgs(int argc, char** argv, BenchOptions& opt) {
+    for (int t = 0; t < NUM_BOID_TYPES; ++t) opt.counts[t] = -1;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((a == "-n" || a == "--per-type") && hasValue) {
+            opt.perType = atoi(argv[++i]);
+        } else if (a == "--count" && hasValue) {
+            int t = 0, n = 0;
+            if (sscanf(argv[++i], "%d=%d", &t, &n) != 2 || t < 0 || t >= NUM_BOID_TYPES) {
+                printf("Invalid count \"%s\", expected TYPE=N\n", argv[i]);
+                return false;
+            }
+            opt.counts[t] = n;
+        } else if ((a == "-s" || a == "--steps") && hasValue) {
+            opt.steps = atoi(argv[++i]);
+        } else if ((a == "-w" || a == "--warmup") && hasValue) {
+            opt.warmup = atoi(argv[++i]);
+        } else if ((a == "-t" || a == "--threads") && hasValue) {
+            opt.threads = atoi(argv[++i]);
+        } else if (a == "--homes" && hasValue) {
+            opt.homes = atoi(argv[++i]);
+        } else if (a == "--floor" && hasValue) {
+            opt.floor = true;
+            opt.floorHeight = atof(argv[++i]);
+        } else if (a == "--seed" && hasValue) {
+            opt.seed = strtoul(argv[++i], nullptr, 10);
+        } else if (a == "--octree") {
+            opt.useGrid = false;
+        } else if (a == "--topological") {
+            opt.topological = true;
+        } else if (a == "--lists") {
+            opt.neighbourLists = true;
+        } else if (a == "--simd") {
+            opt.simd = true;
+        } else if (a == "--no-simd") {
+            opt.simd = false;
+        } else if (a == "--no-reorder") {
+            opt.reorder = false;
+        } else if (a == "--no-split") {
+            opt.splitTypes = false;
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Peak resident memory of the process, in MiB
+static double peakMemoryMiB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+    return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss / 1024.0;  // kilobytes on linux
+#endif
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parseArgs(argc, argv, opt)) return 1;
+
+    Util::mt_gen.seed(opt.seed);
+    std::vector<std::pair<BoidType, int>> counts;
+    for (int t = 0; t < NUM_BOID_TYPES; ++t) {
+        int n = opt.counts[t] < 0 ? opt.perType : opt.counts[t];
+        if (n > 0) counts.push_back({(BoidType)t, n});
+    }
+
+    std::vector<vec3> homes;
+    for (int i = 0; i < opt.homes; ++i) homes.push_back(vec3(Util::random(WORLD_BOUND_LOW, WORLD_BOUND_HIGH), 0, Util::random(WORLD_BOUND_LOW, WORLD_BOUND_HIGH)));
+
+    Flock* flock = new Flock(counts, homes);
+    if (flock->boid_count == 0) {
+        printf("No boids to simulate\n");
+        return 1;
+    }
+    if (opt.threads > 0) {
+        delete flock->pool;
+        flock->pool = new ThreadPool(opt.threads);
+        flock->queryScratch.resize(flock->pool->size() * QUERY_SCRATCH_SIZE);
+    }
+    flock->useGrid = opt.useGrid;
+    flock->topologicalNeighbours = opt.topological;
+    flock->useNeighbourLists = opt.neighbourLists;
+    flock->reorderBoids = opt.reorder;
+    flock->splitTypeQueries = opt.splitTypes;
+    BoidKernel::useSIMD = opt.simd;
+    if (opt.floor) {
+        vec3 l = SM::sceneBox->low, h = SM::sceneBox->high;
+        float y = opt.floorHeight;
+        flock->setObstacles(new DistanceField({vec3(l.x, y, l.z), vec3(l.x, y, h.z), vec3(h.x, y, l.z),
+                                               vec3(h.x, y, l.z), vec3(l.x, y, h.z), vec3(h.x, y, h.z)},
+                                              *SM::sceneBox));
+    }
+    flock->reset();  // spread the boids over the level, like the scene does once it starts
+
+    // everything is updated, as if the player was in the middle of the whole school
+    vec3 centre = vec3(0);
+    float distance = WORLD_BOUND_HIGH * 4;
+
+    printf("%d boids, %d types, %d homes, %u threads, %s%s%s%s%s\n", flock->boid_count, (int)counts.size(), opt.homes, flock->pool->size(),
+           opt.useGrid ? "grid" : (opt.topological ? "octree (topological)" : "octree"),
+           opt.neighbourLists ? ", neighbour lists" : "",
+           opt.simd && BoidKernel::hasAVX2() ? ", simd" : "",
+           opt.reorder ? ", reorder" : "",
+           opt.floor ? ", floor" : "");
+
+    for (int i = 0; i < opt.warmup; ++i) flock->process(centre, distance);
+
+    flock->neighboursFound = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < opt.steps; ++i) flock->process(centre, distance);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double boidSteps = (double)flock->boid_count * opt.steps;
+    printf("steps:          %d in %.3f s\n", opt.steps, seconds);
+    printf("steps/sec:      %.2f\n", opt.steps / seconds);
+    printf("ns/boid/step:   %.2f\n", seconds * 1e9 / boidSteps);
+    printf("avg neighbours: %.2f\n", flock->neighboursFound / boidSteps);
+    printf("peak memory:    %.2f MiB\n", peakMemoryMiB());
+    return 0;
+}
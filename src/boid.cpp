@@ -1,98 +1,56 @@
 #include "boid.h"
+#include "boidkernel.h"
+#include "distancefield.h"
+#include "homegrid.h"
 using namespace BoidInfo;
 
-void Boid::process(BoidContainer*& bc, const unsigned* indices, int neighbours, std::vector<vec3> homes) {
-    dir = normalize(velocity);
-    move(bc, indices, neighbours, homes);
+// `obstacles` can be null, if there's nothing to avoid
+void Boid::process(const unsigned* indices, int neighbours, const HomeGrid& homes, const DistanceField* obstacles) {
+    bc->dir[ID] = normalize(bc->velocity[ID]);
+    move(indices, neighbours, homes);  // writes bc->nextVelocity
+    if (obstacles) avoidObstacles(*obstacles);
     limitSpeed();
     update();
 }
 
-void Boid::move(BoidContainer*& bc, const unsigned* indices, int neighbours, std::vector<vec3> homes) {
-    int numNeighbors = neighbours;
-    int numFamily = 0;  // only move by family rules if near family. otherwise, boid will move towards origin due to subtraction in alignment and cohesion checks
+void Boid::move(const unsigned* indices, int neighbours, const HomeGrid& homes) {
+    const vec3 pos = bc->pos[ID];
+    const BoidType type = bc->type[ID];
+    const BoidTraits& tr = bc->traits[ID];
+    vec3 velocity = bc->velocity[ID];
+    vec3& currentHome = bc->currentHome[ID];
+    int& hasHome = bc->hasHome[ID];
 
-    // alignment variable
-    vec3 avgVel(0);
+    int numNeighbors = neighbours;
 
-    // cohesion
-    vec3 avgCentre(0);
+    // sum up alignment, cohesion, separation, fleeing and attacking over all neighbours
+    NeighbourSums sums;
+    BoidKernel::accumulate(bc, ID, indices, neighbours, SM::canBoidsAttack, sums);
 
-    // separation variables
-    vec3 avgMove(0);
+    int numFamily = sums.numFamily;  // only move by family rules if near family. otherwise, boid will move towards origin due to subtraction in alignment and cohesion checks
+    vec3 avgVel = sums.avgVel;
+    vec3 avgCentre = sums.avgCentre;
+    vec3 avgMove = sums.avgMove;
     // if being chased, ignore all prey. define separate attacking and fleeing so that any behaviour defined
     // before fully seen (i.e., deciding to chase before finding a predator in boid list) can be undone
-    vec3 avgMoveAtt(0);
-    vec3 avgMoveFlee(0);
-
-    bool isBeingChased = false;    // am i being chased?
-    bool isInPursuit = false;      // am i chasing prey (intercepting or chasing)
-    bool isInChasing = false;      // am i chasing prey (chasing only)
-    vec3 closestPrey = vec3(1e9);  // chase closest prey instead of group if it's within chase distance
-    float closestPreyDist = 1e9;
-    float biggestFearWeight = 0;
-
-    for (int i = 0; i < neighbours; ++i) {
-        Boid* otherBoid = bc->boids[indices[i]];
-        if (otherBoid->ID == ID) continue;
-        float distFromBoid = distance(pos, otherBoid->pos); // todo: only need sq distance for comparisons
-        // numNeighbors++;
-        if (isFamily(type, otherBoid->type)) {
-            // stay within group of same boid type
-            numFamily++;
-
-            // alignment
-            avgVel += otherBoid->velocity;
-
-            // cohesion
-            avgCentre += otherBoid->pos;
+    vec3 avgMoveAtt = sums.avgMoveAtt * getBoidGoalWeight(type);
+    vec3 avgMoveFlee = sums.avgMoveFlee * sums.fearWeight;
+    float biggestFearWeight = sums.fearWeight;
 
-            // separation
-            if (distFromBoid < getBoidSepDistance(type)) {
-                avgMove += pos - otherBoid->pos;
-            }
-        } else if (!SM::canBoidsAttack) {
-            // to avoid altering if-statement structure in case i decide to remove this
-            // todo: add slight flocking behaviour to non-enemmies
-        } else {
-            if (isPreyTo(type, otherBoid->type)) {
-                if (distFromBoid <= getBoidInterceptDistance(type)) {
-                    isBeingChased = true;
-                }
-                biggestFearWeight = max(biggestFearWeight, getBoidFearWeight(type, otherBoid->type));
-                avgMoveFlee += (pos - otherBoid->pos) * biggestFearWeight;
-            } else if (isPredatorTo(type, otherBoid->type)) {
-                isInPursuit = isInPursuit || distFromBoid <= getBoidInterceptDistance(type);
-                if (distFromBoid <= getBoidChaseDistance(type)) {
-                    // move towards goal
-                    isInChasing = true;
-                    if (distFromBoid < closestPreyDist) {
-                        closestPrey = otherBoid->pos;
-                        closestPreyDist = distFromBoid;
-                    }
-                    avgMoveAtt -= (pos - otherBoid->pos) * getBoidGoalWeight(type);
-                } else if (distFromBoid <= getBoidInterceptDistance(type)) {
-                    // intercept goal
-                    // doing it like this means predators are drawn towards larger groups more than single prey
-                    avgMoveAtt -= (pos - (otherBoid->pos + otherBoid->velocity)) * getBoidGoalWeight(type);
-                }
-            }
-        }
-    }
+    bool isBeingChased = sums.isBeingChased;  // am i being chased?
+    bool isInPursuit = sums.isInPursuit;      // am i chasing prey (intercepting or chasing)
+    bool isInChasing = sums.isInChasing;      // am i chasing prey (chasing only)
+    vec3 closestPrey = sums.closestPrey;      // chase closest prey instead of group if it's within chase distance
 
     // Determine where the home is
     if (getHomeValidation(type)) {
-        if (Util::sqDist(pos, currentHome) > homeRange * homeRange) {
+        if (Util::sqDist(pos, currentHome) > tr.homeRange * tr.homeRange) {
             hasHome = false;
-            float consideredHomeDist = isBeingChased ? newHomeDistFlee * newHomeDistFlee : newHomeDistDrift * newHomeDistDrift;
-            for (vec3 home : homes) {
-                if (Util::sqDist(pos, home) < consideredHomeDist) {
-                    // printf("%.2f\n", Util::sqDist(pos, currentHome));
-                    // Util::printVec3(home);
-                    currentHome = home;
-                    hasHome = true;
-                    break;
-                }
+            float consideredHomeDist = isBeingChased ? tr.newHomeDistFlee : tr.newHomeDistDrift;
+            int home = homes.getNearestHome(pos, consideredHomeDist);
+            if (home != -1) {
+                currentHome = homes.homes[home];
+                hasHome = true;
             }
         }
     }
@@ -126,15 +84,24 @@ void Boid::move(BoidContainer*& bc, const unsigned* indices, int neighbours, std
         }
         velocity += avgMove * getBoidAvoidFactor(type);
     }
+    bc->nextVelocity[ID] = velocity;
+}
+
+// Steer away from static geometry, harder the closer the boid is to it
+void Boid::avoidObstacles(const DistanceField& obstacles) {
+    vec4 o = obstacles.sample(bc->pos[ID]);
+    if (o.w < obstacles.avoidRange) bc->nextVelocity[ID] += vec3(o) * (obstacles.avoidRange - o.w) * obstacles.avoidWeight;
 }
 
 void Boid::limitSpeed() {
+    vec3& velocity = bc->nextVelocity[ID];
+    BoidType type = bc->type[ID];
     float tspeed = dot(velocity, velocity);
     // can use glsl's isnan in a compute shader, so this is fine: https://registry.khronos.org/OpenGL-Refpages/gl4/html/isnan.xhtml
     if (glm::any(glm::isnan(velocity))) resetVelocity();
     if (tspeed < getBoidMinSpeed(type) * getBoidMinSpeed(type)) {
         velocity *= 1.1f;
-        dir = normalize(velocity);
+        bc->dir[ID] = normalize(velocity);
     } else {
         float max_speed = getBoidMaxSpeed(type);
         if (tspeed > max_speed * max_speed) {
@@ -144,6 +111,10 @@ void Boid::limitSpeed() {
 }
 
 void Boid::update() {
+    vec3& pos = bc->nextPos[ID];
+    vec3& velocity = bc->nextVelocity[ID];
+    vec3& lastVelocity = bc->lastVelocity[ID];
+    pos = bc->pos[ID];
     float tf = 1;
     if (pos.x < WORLD_BOUND_LOW)
         velocity.x += tf;
@@ -158,10 +129,10 @@ void Boid::update() {
     if (pos.z > WORLD_BOUND_HIGH)
         velocity.z -= tf;
     if (glm::any(glm::isnan(velocity))) resetVelocity();
-    lastVelocity = Util::lerpV(lastVelocity, velocity, SM::delta * lerpAcceleration);
-    pos += lastVelocity * SM::delta;
+    lastVelocity = Util::lerpV(lastVelocity, velocity, SM::simStep * lerpAcceleration);
+    pos += lastVelocity * SM::simStep;
 }
 
 void Boid::resetVelocity() {
-    velocity = normalize(Util::randomv(-5, 5));
+    bc->nextVelocity[ID] = normalize(Util::randomv(-5, 5));
 }
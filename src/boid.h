@@ -7,54 +7,141 @@
 #include "boidinfo.h"
 #include "util.h"
 #include "sm.h"
+#ifndef HEADLESS
 #include "variantmesh.h"
+#endif
 using namespace glm;
 
+class HomeGrid;
+class DistanceField;
+
+// Per-boid constants. Only read by the boid itself, so kept out of the arrays walked for every neighbour.
+struct BoidTraits {
+    float visibleRange = 8;       // the distance the boid will check for other boids
+    float newHomeDistDrift = 20;  // distance to determine new home when drifting (i.e., not fleeing or chasing)
+    float newHomeDistFlee = 10;   // distance to determine new home when fleeing
+    float homeRange = 40;         // distance to consider current home valid
+    int canHaveHome = 0;
+};
+
 // Container struct for boids. Since the octree will need to access the boids, I don't want each subtree having a copy of the boid list.
 // It was either this or keeping the boids in the Scene Manager, which seemed stupid.
+// Stored as a structure of arrays indexed by slot, so the neighbour loop only pulls in the fields it reads.
+// Slots start out equal to each boid's external ID (its instance index), but `reorder` can move boids around so that boids
+// close in space are close in memory. `ids` and `slots` map between the two.
+// Position and velocity are double buffered: a step reads the previous state of every boid and writes the next state,
+// so boids can be updated in any order (or in parallel) with the same result.
 struct BoidContainer {
-    Boid** boids;
-    unsigned size;
+    // read for every neighbour visit
+    std::vector<vec3> pos;       /* position */
+    std::vector<vec3> velocity;  /* current velocity of boid */
+    std::vector<BoidType> type;
+
+    // written during a step, becomes `pos` and `velocity` after `swap()`
+    std::vector<vec3> nextPos;
+    std::vector<vec3> nextVelocity;
+
+    // only touched by the boid itself
+    std::vector<vec3> dir;           /* current direction of boid; always equal to normalised velocity */
+    std::vector<vec3> lastVelocity;  /* last velocity of boid, before movement transformations. used for lerping */
+    std::vector<vec3> currentHome;   /* location of safe area */
+    std::vector<int> hasHome;
+    std::vector<BoidTraits> traits;
+
+    std::vector<unsigned> ids;    // external ID of the boid in each slot
+    std::vector<unsigned> slots;  // slot of each external ID
+
+    unsigned size = 0;
+
+    void reserve(unsigned n) {
+        pos.reserve(n);
+        velocity.reserve(n);
+        nextPos.reserve(n);
+        nextVelocity.reserve(n);
+        type.reserve(n);
+        dir.reserve(n);
+        lastVelocity.reserve(n);
+        currentHome.reserve(n);
+        hasHome.reserve(n);
+        traits.reserve(n);
+        ids.reserve(n);
+        slots.reserve(n);
+    }
+
+    // add a boid and return its slot, which is also its external ID
+    unsigned add(vec3 _pos, vec3 vel, BoidType t) {
+        vec3 nVel = normalize(vel);
+        pos.push_back(_pos);
+        velocity.push_back(nVel);
+        nextPos.push_back(_pos);
+        nextVelocity.push_back(nVel);
+        type.push_back(t);
+        dir.push_back(nVel);
+        lastVelocity.push_back(nVel);
+        currentHome.push_back(vec3(0, 0, 0));
+        hasHome.push_back(0);
+        traits.push_back(BoidTraits());
+        ids.push_back(size);
+        slots.push_back(size);
+        return size++;
+    }
+
+    // make the state written this step the current state
+    void swap() {
+        std::swap(pos, nextPos);
+        std::swap(velocity, nextVelocity);
+    }
+
+    // Move the boid in slot `order[i]` to slot `i`, for every per-boid array
+    void reorder(const std::vector<unsigned>& order) {
+        permute(pos, order);
+        permute(velocity, order);
+        permute(type, order);
+        permute(nextPos, order);
+        permute(nextVelocity, order);
+        permute(dir, order);
+        permute(lastVelocity, order);
+        permute(currentHome, order);
+        permute(hasHome, order);
+        permute(traits, order);
+        permute(ids, order);
+        for (unsigned i = 0; i < size; ++i) slots[ids[i]] = i;
+    }
+
+   private:
+    template <typename T>
+    static void permute(std::vector<T>& v, const std::vector<unsigned>& order) {
+        std::vector<T> tmp(v.size());
+        for (unsigned i = 0; i < order.size(); ++i) tmp[i] = v[order[i]];
+        v.swap(tmp);
+    }
 };
 
+// Handle to a single boid in a BoidContainer. `process` reads the current state and writes the next state.
 class Boid {
    private:
     float lerpAcceleration = 8; /* how fast to lerp velocity */
    public:
-    Boid(vec3 _pos, vec3 vel, BoidType t, int id) {
-        pos = _pos;
-        velocity = vel;
-        vec3 nVel = normalize(velocity);
-        dir = nVel;
-        velocity = nVel;
-        lastVelocity = nVel;
-        type = t;
-        ID = id;
-    }
+    Boid(BoidContainer* _bc, unsigned id) : bc(_bc), ID(id) {}
 
     ~Boid() {}
 
-    void process(BoidContainer*&, const unsigned*, int, std::vector<vec3> homes);
-    void move(BoidContainer*&, const unsigned*, int, std::vector<vec3> homes);
+    void process(const unsigned*, int, const HomeGrid& homes, const DistanceField* obstacles);
+    void move(const unsigned*, int, const HomeGrid& homes);
+    void avoidObstacles(const DistanceField& obstacles);
     void limitSpeed();
     void update();
     void resetVelocity();
 
-    float visibleRange = 8;           /* the distance the boid will check for other boids */
-    vec3 currentHome = vec3(0, 0, 0); /* location of safe area */
-    int canHaveHome = 0;
-    int hasHome = 0;
-    float newHomeDistDrift = 20;  // distance to determine new home when drifting (i.e., not fleeing or chasing)
-    float newHomeDistFlee = 10;   // distance to determine new home when fleeing
-    float homeRange = 40;         // distance to consider current home valid
+    vec3& pos() { return bc->pos[ID]; }
+    vec3& velocity() { return bc->velocity[ID]; }
+    vec3& dir() { return bc->dir[ID]; }
+    vec3& lastVelocity() { return bc->lastVelocity[ID]; }
+    BoidType type() { return bc->type[ID]; }
+    const BoidTraits& traits() { return bc->traits[ID]; }
 
-    vec3 pos;              /* position */
-    vec3 velocity;         /* current velocity of boid */
-    vec3 dir;              /* current direction of boid; always equal to normalised velocity */
-    vec3 lastVelocity;     /* last velocity of boid, before movement transformations. used for lerping */
-    bool isCaught = false; /* was this boid caught by a predator? :( */
-    unsigned ID;           /* ID of boid */
-    BoidType type;
+    BoidContainer* bc;
+    unsigned ID; /* slot of boid in the container */
 };
 
 #endif /* BOID_H */
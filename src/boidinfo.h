@@ -1,8 +1,6 @@
 #ifndef BOIDINFO_H
 #define BOIDINFO_H
 
-#include <set>
-#include <map>
 #include "util.h"
 
 class Boid;
@@ -10,37 +8,48 @@ class Flock;
 
 #define NUM_BOID_TYPES 11
 
-// boid struct. smaller representation of a Boid object. used for compute shaders
+// bits of BoidS::flags
+#define BOID_FLAG_HAS_HOME 1u
+#define BOID_FLAG_BEING_CHASED 2u
+#define BOID_FLAG_CHASING 4u
+
+// boid struct. the state of a single boid that changes every frame. used for compute shaders
 struct BoidS {
     vec4 pos;
     vec4 velocity;
     vec4 lastVelocity;
-    vec4 dir;
-    vec4 scale;
     vec4 home;
-    vec2 bounds;
+    unsigned int type;
+    unsigned int ID;
+    unsigned int flags;  // BOID_FLAG_*
+    int pd1;             // struct size needs to be divisible by 16
+};
+
+// boid type struct. the parameters shared by every boid of a type, indexed by type in compute shaders
+struct BoidTypeS {
+    float scale;
     float min_speed;
     float max_speed;
     float minSepDistance;
-    float matchingFactor;
-    float centeringFactor;
-    float avoidFactor;
-    float minEnemyInterceptDistance;
     float minEnemyChaseDistance;
-    float fearWeight;
+    float minEnemyInterceptDistance;
+    float avoidFactor;
     float goalWeight;
+    float matchingFactor;
+    float centeringFactor;
+    vec2 bounds;
     int canHaveHome;
-    int hasHome;
-    int isBeingChased;
-    int isChasing;
-    int boidsAround;
-    unsigned int type;
-    unsigned int ID;
-    unsigned int myPredators[NUM_BOID_TYPES + 1];  // needs to be divisible by 4
-    unsigned int myPrey[NUM_BOID_TYPES + 1];
+    unsigned int preyMask;      // types this type hunts
+    unsigned int predatorMask;  // types this type is hunted by
     int pd1;
 };
 
+// instance transform written by boids.comp for drawing. half the size of a mat4
+struct InstanceS {
+    vec4 posScale;  // xyz is the drawn position, w the uniform scale
+    vec4 rotation;  // orientation quaternion (x, y, z, w)
+};
+
 enum BoidType {
     F_THREADFIN,
     F_MARLIN,
@@ -56,25 +65,108 @@ enum BoidType {
 };
 
 namespace BoidInfo {
-extern std::map<BoidType, std::set<BoidType>> preyTable;  // table for each boid's prey
-extern std::map<BoidType, std::set<BoidType>> predTable;  // table for each boid's predators
-extern vec3 getBoidScale(BoidType t);
-extern float getBoidMinSpeed(BoidType t);
-extern float getBoidMaxSpeed(BoidType t);
-extern float getBoidSepDistance(BoidType t);
-extern float getBoidChaseDistance(BoidType t);
-extern float getBoidInterceptDistance(BoidType t);
-extern float getBoidAvoidFactor(BoidType t);
-extern float getBoidGoalWeight(BoidType t);
-extern float getBoidFearWeight(BoidType a, BoidType b);
-extern float getBoidMatchingFactor(BoidType t);
-extern float getBoidCenteringFactor(BoidType t);
-extern vec2 getBoidBounds(BoidType t);
-extern int getHomeValidation(BoidType t);
-extern bool isFamily(BoidType a, BoidType b);
-extern bool isPreyTo(BoidType a, BoidType b);
-extern bool isPredatorTo(BoidType a, BoidType b);
+// Per-type boid parameters
+struct BoidParams {
+    float scale;
+    float minSpeed;
+    float maxSpeed;
+    float sepDistance;
+    float chaseDistance;
+    float interceptDistance;
+    float avoidFactor;
+    float goalWeight;
+    float boundLow;   // lowest y this type can swim to
+    float boundHigh;  // highest y this type can swim to
+    int canHaveHome;
+};
+
+// Parameters of each boid type, indexed by BoidType.
+// max speed is min speed * (1 + k/4), separation distance is scale * k
+inline constexpr BoidParams boidParams[NUM_BOID_TYPES] = {
+    // scale, min speed, max speed, separation, chase, intercept, avoid, goal, bounds, home
+    {.125f, 1, 1 + 8 / 4.f, .125f * 2, 1, 8, .1f, .1f, WORLD_BOUND_LOW, WORLD_BOUND_HIGH, true},    // F_THREADFIN
+    {.5f, 1, 1 + 8 / 4.f, .5f * 2.125f, 1, 8, .1f, .1f, -30, WORLD_BOUND_HIGH, false},              // F_MARLIN     0 - 142
+    {.5f, 1, 1 + 8 / 4.f, .5f * 2.125f, 1, 8, .1f, .1f, 10, WORLD_BOUND_HIGH, false},               // F_SPEAR_FISH 0 - 102
+    {.1f, 1, 1 + 8 / 4.f, .1f * 2, 1, 8, .1f, .1f, WORLD_BOUND_LOW, WORLD_BOUND_HIGH, true},        // F_HERRING
+    {.1f, 1, 1 + 8 / 4.f, .1f * 2, 1, 8, .1f, .1f, WORLD_BOUND_LOW, WORLD_BOUND_HIGH, true},        // F_CLOWNFISH
+    {1, 1, 1 + 12 / 4.f, 1 * 2.5f, 1.5f, 8, .1f, .2f, WORLD_BOUND_LOW, 80, false},                  // S_BLUE       20 - 224
+    {1.5f, 1, 1 + 12 / 4.f, 1.5f * 3, 2, 8, .1f, .1f, WORLD_BOUND_LOW, WORLD_BOUND_HIGH, false},    // S_WHALE
+    {1, 1, 1 + 12 / 4.f, 1 * 2.5f, 2, 8, .1f, .4f, -50, WORLD_BOUND_HIGH, false},                   // S_WHITE      0 - 162. more aggressive
+    {2, 1, 1 + 2 / 4.f, 2 * 4, 2, 2, .1f, .1f, WORLD_BOUND_LOW, WORLD_BOUND_HIGH, false},           // WHALE
+    {.5f, 1, 1 + 32 / 4.f, .5f * 2, 2, 8, .1f, .1f, 50, WORLD_BOUND_HIGH, false},                   // DOLPHIN      0 - 52
+    {.1f, 1, 1 + 4 / 4.f, .1f * 2, .5f, 1, .1f, .1f, WORLD_BOUND_LOW, WORLD_BOUND_HIGH, true},      // PLANKTON
+};
+
+constexpr unsigned typeBit(BoidType t) { return 1u << t; }
+
+template <typename... Ts>
+constexpr unsigned typeMask(Ts... ts) { return (0u | ... | typeBit(ts)); }
+
+constexpr unsigned FISH_MASK = typeMask(F_THREADFIN, F_MARLIN, F_SPEAR_FISH, F_HERRING, F_CLOWNFISH);
+
+// Bitmask of the types each type hunts, indexed by BoidType
+inline constexpr unsigned preyMasks[NUM_BOID_TYPES] = {
+    typeMask(PLANKTON),                                 // F_THREADFIN
+    typeMask(PLANKTON),                                 // F_MARLIN
+    typeMask(PLANKTON),                                 // F_SPEAR_FISH
+    typeMask(PLANKTON),                                 // F_HERRING
+    typeMask(PLANKTON),                                 // F_CLOWNFISH
+    typeMask(PLANKTON) | FISH_MASK,                     // S_BLUE
+    typeMask(PLANKTON, F_HERRING),                      // S_WHALE
+    typeMask(PLANKTON, DOLPHIN) | FISH_MASK,            // S_WHITE
+    typeMask(PLANKTON, F_HERRING),                      // WHALE
+    typeMask(PLANKTON) | FISH_MASK,                     // DOLPHIN
+    0,                                                  // PLANKTON
+};
+
+// Bitmask of the types each type is hunted by, indexed by BoidType
+inline constexpr unsigned predatorMasks[NUM_BOID_TYPES] = {
+    typeMask(DOLPHIN, S_BLUE, S_WHITE, WHALE),           // F_THREADFIN
+    typeMask(DOLPHIN, S_BLUE, S_WHITE, WHALE),           // F_MARLIN
+    typeMask(DOLPHIN, S_BLUE, S_WHITE, WHALE),           // F_SPEAR_FISH
+    typeMask(DOLPHIN, S_BLUE, S_WHALE, S_WHITE, WHALE),  // F_HERRING
+    typeMask(DOLPHIN, S_BLUE, S_WHALE, S_WHITE, WHALE),  // F_CLOWNFISH
+    0,                                                   // S_BLUE
+    0,                                                   // S_WHALE
+    typeMask(WHALE),                                     // S_WHITE. scared for no reason (dumb idiot)
+    0,                                                   // WHALE
+    0,                                                   // DOLPHIN
+    typeMask(S_BLUE, S_WHALE, S_WHITE, WHALE, DOLPHIN) | FISH_MASK,  // PLANKTON
+};
+
+inline vec3 getBoidScale(BoidType t) { return vec3(boidParams[t].scale); }
+constexpr float getBoidMinSpeed(BoidType t) { return boidParams[t].minSpeed; }
+constexpr float getBoidMaxSpeed(BoidType t) { return boidParams[t].maxSpeed; }
+constexpr float getBoidSepDistance(BoidType t) { return boidParams[t].sepDistance; }
+constexpr float getBoidChaseDistance(BoidType t) { return boidParams[t].chaseDistance; }
+constexpr float getBoidInterceptDistance(BoidType t) { return boidParams[t].interceptDistance; }
+constexpr float getBoidAvoidFactor(BoidType t) { return boidParams[t].avoidFactor; }
+constexpr float getBoidGoalWeight(BoidType t) { return boidParams[t].goalWeight; }
+constexpr float getBoidMatchingFactor(BoidType t) { return 0.05f; }
+constexpr float getBoidCenteringFactor(BoidType t) { return 0.005f; }
+inline vec2 getBoidBounds(BoidType t) { return {boidParams[t].boundLow, boidParams[t].boundHigh}; }
+// Can this boid type have a home?
+constexpr int getHomeValidation(BoidType t) { return boidParams[t].canHaveHome; }
+constexpr bool isFamily(BoidType a, BoidType b) { return a == b; }
+// Is `a` prey to `b`?
+constexpr bool isPreyTo(BoidType a, BoidType b) { return predatorMasks[a] & typeBit(b); }
+// Is `a` a predator to `b`?
+constexpr bool isPredatorTo(BoidType a, BoidType b) { return preyMasks[a] & typeBit(b); }
+// Bitmask of the types that are predators or prey to `t`
+constexpr unsigned relationMask(BoidType t) { return (preyMasks[t] | predatorMasks[t]) & ~typeBit(t); }
+
+constexpr float getBoidFearWeight(BoidType a, BoidType b) {
+    if (isPreyTo(a, b)) {
+        return 5;
+    } else if (isPredatorTo(a, b) || isFamily(a, b)) {
+        return 0;
+    } else {
+        return std::max(boidParams[b].scale / boidParams[a].scale - boidParams[a].scale, 0.f);
+    }
+}
+
 extern BoidS createBoidStruct(BoidType t, unsigned id, vec3 pos, vec3 dirs);
+extern BoidTypeS createBoidTypeStruct(BoidType t);
 extern std::string getBoidName(BoidType t);
 }  // namespace BoidInfo
 
@@ -0,0 +1,274 @@
+#include "boidkernel.h"
+
+#include <array>
+
+#ifdef BOIDKERNEL_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace BoidInfo;
+
+namespace BoidKernel {
+
+bool useSIMD = false;  // off by default: on real flocks it only breaks even with the scalar kernel
+
+// Bitmasks over BoidType of the types each type flees from and chases, so the kernels don't touch the relation tables per neighbour
+struct TypeMasks {
+    unsigned flee = 0;     // types this type is prey to
+    unsigned chase = 0;    // types this type is a predator to (and not prey to)
+    float fearWeight = 0;  // largest fear weight over `flee`
+};
+
+static constexpr std::array<TypeMasks, NUM_BOID_TYPES> typeMasks = [] {
+    std::array<TypeMasks, NUM_BOID_TYPES> masks{};
+    for (int a = 0; a < NUM_BOID_TYPES; ++a) {
+        const unsigned notFamily = ~typeBit((BoidType)a);  // family is always checked first
+        masks[a].flee = predatorMasks[a] & notFamily;
+        masks[a].chase = preyMasks[a] & ~predatorMasks[a] & notFamily;
+        for (int b = 0; b < NUM_BOID_TYPES; ++b) {
+            if (masks[a].flee & typeBit((BoidType)b)) masks[a].fearWeight = std::max(masks[a].fearWeight, getBoidFearWeight((BoidType)a, (BoidType)b));
+        }
+    }
+    return masks;
+}();
+
+bool hasAVX2() {
+#ifdef BOIDKERNEL_AVX2
+    static bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Accumulate the neighbours in `indices` of boid `id` into `sums`, which should be freshly constructed
+void accumulate(const BoidContainer* bc, unsigned id, const unsigned* indices, int count, bool canAttack, NeighbourSums& sums) {
+#ifdef BOIDKERNEL_AVX2
+    if (useSIMD && hasAVX2() && count >= SIMD_MIN_NEIGHBOURS) {
+        accumulateAVX2(bc, id, indices, count, canAttack, sums);
+#ifdef SIMD_VERIFY
+        NeighbourSums ref;
+        accumulateScalar(bc, id, indices, count, canAttack, ref);
+        if (!compare(sums, ref, 1e-3f)) printf("SIMD kernel mismatch for boid %u\n", id);
+#endif
+        return;
+    }
+#endif
+    accumulateScalar(bc, id, indices, count, canAttack, sums);
+}
+
+void accumulateScalar(const BoidContainer* bc, unsigned id, const unsigned* indices, int count, bool canAttack, NeighbourSums& sums) {
+    const vec3* bPos = bc->pos.data();
+    const vec3* bVel = bc->velocity.data();
+    const BoidType* bType = bc->type.data();
+
+    const vec3 pos = bPos[id];
+    const BoidType type = bType[id];
+    const TypeMasks& m = typeMasks[type];
+    const float sep2 = getBoidSepDistance(type) * getBoidSepDistance(type);
+    const float icpt2 = getBoidInterceptDistance(type) * getBoidInterceptDistance(type);
+    const float chase2 = getBoidChaseDistance(type) * getBoidChaseDistance(type);
+
+    for (int i = 0; i < count; ++i) {
+        unsigned o = indices[i];
+        if (o == id) continue;
+        const vec3 d = pos - bPos[o];
+        const float d2 = dot(d, d);
+        const unsigned bit = 1u << bType[o];
+        if (bType[o] == type) {
+            // stay within group of same boid type
+            sums.numFamily++;
+            sums.avgVel += bVel[o];     // alignment
+            sums.avgCentre += bPos[o];  // cohesion
+            if (d2 < sep2) sums.avgMove += d;  // separation
+        } else if (!canAttack) {
+            // to avoid altering if-statement structure in case i decide to remove this
+        } else if (m.flee & bit) {
+            if (d2 <= icpt2) sums.isBeingChased = true;
+            sums.fearWeight = std::max(sums.fearWeight, getBoidFearWeight(type, bType[o]));
+            sums.avgMoveFlee += d;
+        } else if (m.chase & bit) {
+            sums.isInPursuit = sums.isInPursuit || d2 <= icpt2;
+            if (d2 <= chase2) {
+                // move towards goal
+                sums.isInChasing = true;
+                if (d2 < sums.closestPreyDist) {
+                    sums.closestPrey = bPos[o];
+                    sums.closestPreyDist = d2;
+                }
+                sums.avgMoveAtt -= d;
+            } else if (d2 <= icpt2) {
+                // intercept goal
+                // doing it like this means predators are drawn towards larger groups more than single prey
+                sums.avgMoveAtt -= d - bVel[o];
+            }
+        }
+    }
+}
+
+#ifdef BOIDKERNEL_AVX2
+static_assert(sizeof(vec3) == 3 * sizeof(float), "transposed loads assume tightly packed vec3");
+static_assert(sizeof(BoidType) == sizeof(int), "type loads assume int sized BoidType");
+
+__attribute__((target("avx2"))) static inline float hsum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+// Load the vec3s at `base[indices[0..8]]` and transpose them into x, y and z lanes. Each vec3 is one 128-bit masked load,
+// which is far cheaper than three 8-wide gathers with a stride of 3, and never reads past the vec3 (or the end of the array)
+__attribute__((target("avx2"))) static inline void loadTransposed(const float* base, const unsigned* indices, __m256& x, __m256& y, __m256& z) {
+    const __m128i xyz = _mm_setr_epi32(-1, -1, -1, 0);
+    __m128 r[8];
+    for (int l = 0; l < 8; ++l) r[l] = _mm_maskload_ps(base + indices[l] * 3, xyz);
+    _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+    _MM_TRANSPOSE4_PS(r[4], r[5], r[6], r[7]);
+    x = _mm256_set_m128(r[4], r[0]);
+    y = _mm256_set_m128(r[5], r[1]);
+    z = _mm256_set_m128(r[6], r[2]);
+}
+
+// Same as `accumulateScalar`, 8 neighbours at a time. Neighbour data is loaded and transposed straight from the container
+// arrays, and the family/prey/predator branches become lane masks. The remainder is handed to the scalar kernel.
+__attribute__((target("avx2"))) void accumulateAVX2(const BoidContainer* bc, unsigned id, const unsigned* indices, int count, bool canAttack, NeighbourSums& sums) {
+    const float* bPos = &bc->pos[0].x;
+    const float* bVel = &bc->velocity[0].x;
+    const int* bType = (const int*)bc->type.data();
+
+    const vec3 pos = bc->pos[id];
+    const BoidType type = bc->type[id];
+    const TypeMasks& m = typeMasks[type];
+
+    const __m256 px = _mm256_set1_ps(pos.x), py = _mm256_set1_ps(pos.y), pz = _mm256_set1_ps(pos.z);
+    const __m256 sep2 = _mm256_set1_ps(getBoidSepDistance(type) * getBoidSepDistance(type));
+    const __m256 icpt2 = _mm256_set1_ps(getBoidInterceptDistance(type) * getBoidInterceptDistance(type));
+    const __m256 chase2 = _mm256_set1_ps(getBoidChaseDistance(type) * getBoidChaseDistance(type));
+    const __m256i myType = _mm256_set1_epi32(type);
+    const __m256i myId = _mm256_set1_epi32(id);
+    const __m256i fleeBits = _mm256_set1_epi32(canAttack ? m.flee : 0);
+    const __m256i chaseBits = _mm256_set1_epi32(canAttack ? m.chase : 0);
+    const __m256i one = _mm256_set1_epi32(1), zero = _mm256_setzero_si256();
+
+    __m256 velX = _mm256_setzero_ps(), velY = velX, velZ = velX;
+    __m256 cenX = velX, cenY = velX, cenZ = velX;
+    __m256 movX = velX, movY = velX, movZ = velX;
+    __m256 attX = velX, attY = velX, attZ = velX;
+    __m256 fleeX = velX, fleeY = velX, fleeZ = velX;
+    __m256 minD2 = _mm256_set1_ps(sums.closestPreyDist);
+    __m256 minX = velX, minY = velX, minZ = velX;
+    int numFamily = 0, chased = 0, pursuit = 0, chasing = 0, fleeing = 0;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i idx = _mm256_loadu_si256((const __m256i*)(indices + i));
+        __m256 ox, oy, oz, ovx, ovy, ovz;
+        loadTransposed(bPos, indices + i, ox, oy, oz);
+        loadTransposed(bVel, indices + i, ovx, ovy, ovz);
+        const __m256i ot = _mm256_setr_epi32(bType[indices[i]], bType[indices[i + 1]], bType[indices[i + 2]], bType[indices[i + 3]],
+                                             bType[indices[i + 4]], bType[indices[i + 5]], bType[indices[i + 6]], bType[indices[i + 7]]);
+
+        const __m256 dx = _mm256_sub_ps(px, ox), dy = _mm256_sub_ps(py, oy), dz = _mm256_sub_ps(pz, oz);
+        const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+        // lane masks. family is checked first, then prey-to, then predator-to, same as the scalar kernel
+        const __m256i self = _mm256_cmpeq_epi32(idx, myId);
+        const __m256i bit = _mm256_sllv_epi32(one, ot);
+        const __m256 fam = _mm256_castsi256_ps(_mm256_andnot_si256(self, _mm256_cmpeq_epi32(ot, myType)));
+        const __m256i isFlee = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(bit, fleeBits), zero), _mm256_cmpeq_epi32(zero, zero));
+        const __m256i isChase = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(bit, chaseBits), zero), _mm256_cmpeq_epi32(zero, zero));
+        const __m256 flee = _mm256_andnot_ps(fam, _mm256_castsi256_ps(_mm256_andnot_si256(self, isFlee)));
+        const __m256 chase = _mm256_andnot_ps(_mm256_or_ps(fam, flee), _mm256_castsi256_ps(_mm256_andnot_si256(self, isChase)));
+
+        const __m256 inSep = _mm256_cmp_ps(d2, sep2, _CMP_LT_OQ);
+        const __m256 inIcpt = _mm256_cmp_ps(d2, icpt2, _CMP_LE_OQ);
+        const __m256 inChase = _mm256_cmp_ps(d2, chase2, _CMP_LE_OQ);
+
+        // family: alignment, cohesion, separation
+        numFamily += __builtin_popcount(_mm256_movemask_ps(fam));
+        velX = _mm256_add_ps(velX, _mm256_and_ps(fam, ovx));
+        velY = _mm256_add_ps(velY, _mm256_and_ps(fam, ovy));
+        velZ = _mm256_add_ps(velZ, _mm256_and_ps(fam, ovz));
+        cenX = _mm256_add_ps(cenX, _mm256_and_ps(fam, ox));
+        cenY = _mm256_add_ps(cenY, _mm256_and_ps(fam, oy));
+        cenZ = _mm256_add_ps(cenZ, _mm256_and_ps(fam, oz));
+        const __m256 sep = _mm256_and_ps(fam, inSep);
+        movX = _mm256_add_ps(movX, _mm256_and_ps(sep, dx));
+        movY = _mm256_add_ps(movY, _mm256_and_ps(sep, dy));
+        movZ = _mm256_add_ps(movZ, _mm256_and_ps(sep, dz));
+
+        // predators
+        fleeing |= _mm256_movemask_ps(flee);
+        chased |= _mm256_movemask_ps(_mm256_and_ps(flee, inIcpt));
+        fleeX = _mm256_add_ps(fleeX, _mm256_and_ps(flee, dx));
+        fleeY = _mm256_add_ps(fleeY, _mm256_and_ps(flee, dy));
+        fleeZ = _mm256_add_ps(fleeZ, _mm256_and_ps(flee, dz));
+
+        // prey. chase within chase distance, otherwise intercept within intercept distance
+        const __m256 ch = _mm256_and_ps(chase, inChase);
+        const __m256 ic = _mm256_andnot_ps(inChase, _mm256_and_ps(chase, inIcpt));
+        const __m256 att = _mm256_or_ps(ch, ic);
+        pursuit |= _mm256_movemask_ps(_mm256_and_ps(chase, inIcpt));
+        chasing |= _mm256_movemask_ps(ch);
+        attX = _mm256_add_ps(attX, _mm256_sub_ps(_mm256_and_ps(ic, ovx), _mm256_and_ps(att, dx)));
+        attY = _mm256_add_ps(attY, _mm256_sub_ps(_mm256_and_ps(ic, ovy), _mm256_and_ps(att, dy)));
+        attZ = _mm256_add_ps(attZ, _mm256_sub_ps(_mm256_and_ps(ic, ovz), _mm256_and_ps(att, dz)));
+        const __m256 closer = _mm256_and_ps(ch, _mm256_cmp_ps(d2, minD2, _CMP_LT_OQ));
+        minD2 = _mm256_blendv_ps(minD2, d2, closer);
+        minX = _mm256_blendv_ps(minX, ox, closer);
+        minY = _mm256_blendv_ps(minY, oy, closer);
+        minZ = _mm256_blendv_ps(minZ, oz, closer);
+    }
+
+    sums.numFamily += numFamily;
+    sums.avgVel += vec3(hsum(velX), hsum(velY), hsum(velZ));
+    sums.avgCentre += vec3(hsum(cenX), hsum(cenY), hsum(cenZ));
+    sums.avgMove += vec3(hsum(movX), hsum(movY), hsum(movZ));
+    sums.avgMoveAtt += vec3(hsum(attX), hsum(attY), hsum(attZ));
+    sums.avgMoveFlee += vec3(hsum(fleeX), hsum(fleeY), hsum(fleeZ));
+    sums.isBeingChased = sums.isBeingChased || chased;
+    sums.isInPursuit = sums.isInPursuit || pursuit;
+    sums.isInChasing = sums.isInChasing || chasing;
+    if (fleeing) sums.fearWeight = std::max(sums.fearWeight, m.fearWeight);
+    if (chasing) {
+        alignas(32) float lD2[8], lX[8], lY[8], lZ[8];
+        _mm256_store_ps(lD2, minD2);
+        _mm256_store_ps(lX, minX);
+        _mm256_store_ps(lY, minY);
+        _mm256_store_ps(lZ, minZ);
+        for (int l = 0; l < 8; ++l) {
+            if (lD2[l] < sums.closestPreyDist) {
+                sums.closestPreyDist = lD2[l];
+                sums.closestPrey = vec3(lX[l], lY[l], lZ[l]);
+            }
+        }
+    }
+
+    // the rest of the program is built without AVX. leaving the upper halves of the ymm registers dirty makes every SSE
+    // instruction after this pay for it, so they have to be cleared (gcc doesn't do it for target attribute functions)
+    _mm256_zeroupper();
+    accumulateScalar(bc, id, indices + i, count - i, canAttack, sums);
+}
+#endif
+
+// Do the two sets of sums agree to within `tolerance` (relative to the larger magnitude)?
+bool compare(const NeighbourSums& a, const NeighbourSums& b, float tolerance) {
+    auto close = [tolerance](vec3 x, vec3 y) {
+        float scale = std::max(1.f, std::max(length(x), length(y)));
+        return length(x - y) <= tolerance * scale;
+    };
+    return a.numFamily == b.numFamily &&
+           a.isBeingChased == b.isBeingChased &&
+           a.isInPursuit == b.isInPursuit &&
+           a.isInChasing == b.isInChasing &&
+           a.fearWeight == b.fearWeight &&
+           close(a.avgVel, b.avgVel) &&
+           close(a.avgCentre, b.avgCentre) &&
+           close(a.avgMove, b.avgMove) &&
+           close(a.avgMoveAtt, b.avgMoveAtt) &&
+           close(a.avgMoveFlee, b.avgMoveFlee) &&
+           (!a.isInChasing || close(a.closestPrey, b.closestPrey));
+}
+
+}  // namespace BoidKernel
@@ -0,0 +1,46 @@
+#ifndef BOIDKERNEL_H
+#define BOIDKERNEL_H
+
+#include "boid.h"
+#include "boidinfo.h"
+
+// #define SIMD_VERIFY  // uncomment to check every SIMD result against the scalar kernel
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BOIDKERNEL_AVX2
+#endif
+
+#define SIMD_MIN_NEIGHBOURS 16  // fewer neighbours than this go straight to the scalar kernel, as the AVX2 setup isn't worth it
+
+// Sums of neighbour contributions for one boid, before they are averaged and weighted in `Boid::move`.
+// Separation and fleeing vectors point away from neighbours, attacking vectors point towards prey.
+struct NeighbourSums {
+    int numFamily = 0;
+    vec3 avgVel = vec3(0);       // sum of family velocities
+    vec3 avgCentre = vec3(0);    // sum of family positions
+    vec3 avgMove = vec3(0);      // sum of separation offsets from family that are too close
+    vec3 avgMoveAtt = vec3(0);   // sum of offsets towards prey, unweighted
+    vec3 avgMoveFlee = vec3(0);  // sum of offsets away from predators, unweighted
+
+    bool isBeingChased = false;    // am i being chased?
+    bool isInPursuit = false;      // am i chasing prey (intercepting or chasing)
+    bool isInChasing = false;      // am i chasing prey (chasing only)
+    vec3 closestPrey = vec3(1e9);  // chase closest prey instead of group if it's within chase distance
+    float closestPreyDist = 1e9;   // squared
+    float fearWeight = 0;          // largest fear weight of any predator seen
+};
+
+// Neighbour accumulation for the CPU flock. The AVX2 kernel handles 8 neighbours at a time, and is used when `useSIMD` is set
+// and the CPU supports it.
+namespace BoidKernel {
+extern bool useSIMD;
+extern bool hasAVX2();
+extern void accumulate(const BoidContainer* bc, unsigned id, const unsigned* indices, int count, bool canAttack, NeighbourSums& sums);
+extern void accumulateScalar(const BoidContainer* bc, unsigned id, const unsigned* indices, int count, bool canAttack, NeighbourSums& sums);
+#ifdef BOIDKERNEL_AVX2
+extern void accumulateAVX2(const BoidContainer* bc, unsigned id, const unsigned* indices, int count, bool canAttack, NeighbourSums& sums);
+#endif
+extern bool compare(const NeighbourSums& a, const NeighbourSums& b, float tolerance);
+}  // namespace BoidKernel
+
+#endif /* BOIDKERNEL_H */
@@ -338,9 +338,7 @@ void BoneMesh::populateBuffers() {
     glGenBuffers(1, &p_VBO);
     glGenBuffers(1, &n_VBO);
     glGenBuffers(1, &t_VBO);
-    glGenBuffers(1, &d_VBO);
     glGenBuffers(1, &EBO);
-    glGenBuffers(1, &IBO);
     glGenBuffers(1, &BBO);
 
     glBindBuffer(GL_ARRAY_BUFFER, p_VBO);
@@ -369,15 +367,14 @@ void BoneMesh::populateBuffers() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, IBO);
+    // instance transforms and depths are written into the shared instance ring each draw, which rebinds them to where they went
+    glBindBuffer(GL_ARRAY_BUFFER, SM::instanceRing->buffer);
     for (unsigned int i = 0; i < 4; i++) {
         glEnableVertexAttribArray(SK_INSTANCE_LOC + i);
         glVertexAttribPointer(SK_INSTANCE_LOC + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (const void*)(i * sizeof(vec4)));
         glVertexAttribDivisor(SK_INSTANCE_LOC + i, 1);  // tell OpenGL this is an instanced vertex attribute.
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, d_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * SM::MAX_NUM_BOIDS, NULL, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(SK_DEPTH_LOC);
     glVertexAttribPointer(SK_DEPTH_LOC, 1, GL_FLOAT, GL_FALSE, sizeof(float), 0);
     glVertexAttribDivisor(SK_DEPTH_LOC, 1);  // tell OpenGL this is an instanced vertex attribute.
@@ -387,16 +384,17 @@ void BoneMesh::populateBuffers() {
 
 void BoneMesh::render(unsigned int nInstances, const mat4* bone_trans_matrix, const float* depths) {
     mat = bone_trans_matrix[0];
+    GLintptr matOffset = SM::instanceRing->upload(bone_trans_matrix, sizeof(mat4) * nInstances);
+    GLintptr depthOffset = SM::instanceRing->upload(depths, sizeof(float) * nInstances);  // all zeros if `depths` is nullptr
+    if (matOffset < 0 || depthOffset < 0) return;  // too many instances for the ring
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, IBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(mat4) * nInstances, &bone_trans_matrix[0], GL_DYNAMIC_DRAW);
+    SM::instanceRing->bindAttribute(SK_INSTANCE_LOC, 4, matOffset, sizeof(mat4));
+    SM::instanceRing->bindAttribute(SK_DEPTH_LOC, 1, depthOffset, sizeof(float));
 
     for (unsigned int i = 0; i < meshes.size(); i++) {
         unsigned int mIndex = meshes[i].materialIndex;
         assert(mIndex < materials.size());
 
-        glBindBuffer(GL_ARRAY_BUFFER, d_VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * nInstances, &depths[0], GL_DYNAMIC_DRAW);
         if (materials[mIndex].diffTex) materials[mIndex].diffTex->bind(GL_TEXTURE0);
         if (materials[mIndex].mtlsTex) materials[mIndex].mtlsTex->bind(GL_TEXTURE1);
 
@@ -418,8 +416,7 @@ void BoneMesh::render(unsigned int nInstances, const mat4* bone_trans_matrix, co
 }
 
 void BoneMesh::render(unsigned int nInstances, const mat4* bone_trans_matrix) {
-    std::vector<float> dpths(nInstances, 0);
-    render(nInstances, bone_trans_matrix, dpths.data());
+    render(nInstances, bone_trans_matrix, nullptr);
 }
 
 void BoneMesh::render(mat4 mm) {
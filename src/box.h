@@ -2,9 +2,11 @@
 #define BOX_H
 
 #include "sm.h"
-#include "camera.h"
 #include "util.h"
+#ifndef HEADLESS
+#include "camera.h"
 #include "shader.h"
+#endif
 
 class Box {
 public:
@@ -36,21 +38,23 @@ public:
 
     ~Box() {}
 
-    // split the box into 8 octants
+    // split the box into 8 octants, indexed the same as `getOctant`
     std::vector<Box> split() {
-        std::vector<Box> children = {
-            Box(low, centre),
-            Box(vec3(low.x, low.y, centre.z), vec3(centre.x, centre.y, high.z)),
-            Box(vec3(low.x, centre.y, low.z), vec3(centre.x, high.y, centre.z)),
-            Box(vec3(low.x, centre.y, centre.z), vec3(centre.x, high.y, high.z)),
-            Box(centre, high),
-            Box(vec3(centre.x, low.y, low.z), vec3(high.x, centre.y, centre.z)),
-            Box(vec3(centre.x, low.y, centre.z), vec3(high.x, centre.y, high.z)),
-            Box(vec3(centre.x, centre.y, low.z), vec3(high.x, high.y, centre.z)),
-        };
+        std::vector<Box> children;
+        for (int i = 0; i < 8; ++i) children.push_back(getChild(i));
         return children;
     }
 
+    // get the octant of the box at index `octant` (see `getOctant`). doesn't allocate, unlike `split`
+    Box getChild(int octant) {
+        vec3 l = low;
+        vec3 h = centre;
+        if (octant & 4) l.x = centre.x, h.x = high.x;
+        if (octant & 2) l.y = centre.y, h.y = high.y;
+        if (octant & 1) l.z = centre.z, h.z = high.z;
+        return Box(l, h);
+    }
+
     // get the index (0-7) of the octant containing the point `pos`
     int getOctant(vec3 pos) {
         int msk = 0;
@@ -71,11 +75,16 @@ public:
     // i.e., is the box at all touching the given sphere?
     bool inRange(vec3 p, float radSqr) {
         if (contains(p)) return true;
+        return sqDistTo(p) <= radSqr;
+    }
+
+    // squared distance from `p` to the closest point of the box. 0 if `p` is inside the box
+    float sqDistTo(vec3 p) {
         vec3 closest = vec3(0);
         closest.x = std::min(std::max(low.x, p.x), high.x);
         closest.y = std::min(std::max(low.y, p.y), high.y);
         closest.z = std::min(std::max(low.z, p.z), high.z);
-        return Util::sqDist(closest, p) <= radSqr;
+        return Util::sqDist(closest, p);
     }
 
     // give the box a point. if the point is outside the box's bounds, the box will grow to include the point. returns true if the box grew
@@ -107,6 +116,7 @@ public:
         return ps;
     }
 
+#ifndef HEADLESS
     void loadWireframe() {
         shader = new Shader("wire", PROJDIR "Shaders/blank.vert", PROJDIR "Shaders/blank.frag");
         glGenVertexArrays(1, &VAO);
@@ -114,7 +124,7 @@ public:
         glGenBuffers(1, &VBO);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
 
@@ -134,6 +144,7 @@ public:
         glBindVertexArray(0);
         glEnable(GL_CULL_FACE);
     }
+#endif
 
     vec3 low;     // bottom left position
     vec3 high;    // top right position
@@ -145,8 +156,11 @@ private:
     unsigned int VAO;
     unsigned int VBO;
     unsigned int EBO;
+#ifndef HEADLESS
     Shader *shader;
-    std::vector<float> vertices = {
+#endif
+    // shared by every box, so constructing one doesn't allocate
+    static constexpr float vertices[] = {
         // positions
         // https://learnopengl.com/code_viewer_gh.php?code=src/2.lighting/2.2.basic_lighting_specular/basic_lighting_specular.cpp
         -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f,
@@ -191,7 +205,7 @@ private:
         -0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f,
         -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f};
 
-    std::vector<int> indices = {
+    static constexpr int indices[] = {
         0, 1, 2, 3,
         4, 5, 6, 7,
         0, 4, 1, 5, 2, 6, 3, 7};
@@ -45,7 +45,7 @@ void Camera::followTarget(Player* player) {
 }
 
 void Camera::followTarget(Boid* b) {
-    followTarget(b->pos, b->dir);
+    followTarget(b->pos(), b->dir());
 }
 
 void Camera::processMovement() {
@@ -0,0 +1,171 @@
+#include "distancefield.h"
+
+#define DISTANCE_FIELD_MAGIC 0x46445342u  // "BSDF"
+#define DISTANCE_FIELD_VERSION 1u
+
+// header of a cached distance field file, followed by the cells
+struct DistanceFieldHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    int dims[3];
+    float low[3];
+    float cellSize;
+    float band;
+};
+
+// Get the closest point to `p` on the triangle `abc`. From Real-Time Collision Detection (Ericson), 5.1.5
+static vec3 closestPointOnTriangle(vec3 p, vec3 a, vec3 b, vec3 c) {
+    vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0) return a;
+
+    vec3 bp = p - b;
+    float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+    vec3 cp = p - c;
+    float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denom = 1 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Bake the field from a triangle list (three points per triangle, in world space). Only cells within `band` of a
+// triangle's bounds are checked against it.
+DistanceField::DistanceField(const std::vector<vec3>& triangles, Box bound, float _cellSize) : cellSize(_cellSize) {
+    dims = ivec3(max(ceil(bound.size / cellSize), vec3(1)));
+    low = bound.low;
+    size = vec3(dims) * cellSize;
+    band = DISTANCE_FIELD_BAND * cellSize;
+    key = hashInputs(triangles, bound, cellSize);
+
+    // squared distance, offset from the nearest point and the side of the surface the cell is on, kept while baking
+    std::vector<float> nearest(dims.x * dims.y * dims.z, band * band);
+    std::vector<vec4> offsets(nearest.size(), vec4(0));
+    for (unsigned t = 0; t + 2 < triangles.size(); t += 3) {
+        vec3 a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+        vec3 n = cross(b - a, c - a);
+        if (dot(n, n) == 0) continue;  // degenerate
+
+        // cells whose centres are within `band` of the triangle's bounds
+        vec3 lo = (min(min(a, b), c) - band - low) / cellSize - 0.5f;
+        vec3 hi = (max(max(a, b), c) + band - low) / cellSize - 0.5f;
+        ivec3 first = ivec3(clamp(ceil(lo), vec3(0), vec3(dims - 1)));
+        ivec3 last = ivec3(clamp(floor(hi), vec3(0), vec3(dims - 1)));
+        if (any(lessThan(hi, vec3(0))) || any(greaterThan(lo, vec3(dims - 1)))) continue;
+
+        for (int z = first.z; z <= last.z; ++z) {
+            for (int y = first.y; y <= last.y; ++y) {
+                for (int x = first.x; x <= last.x; ++x) {
+                    vec3 centre = low + (vec3(x, y, z) + 0.5f) * cellSize;
+                    vec3 offset = centre - closestPointOnTriangle(centre, a, b, c);
+                    float d = dot(offset, offset);
+                    unsigned i = flatten(ivec3(x, y, z));
+                    if (d < nearest[i]) {
+                        nearest[i] = d;
+                        offsets[i] = vec4(offset, dot(offset, n) < 0 ? -1 : 1);
+                    }
+                }
+            }
+        }
+    }
+
+    cells.resize(nearest.size());
+    for (unsigned i = 0; i < cells.size(); ++i) {
+        float d = sqrt(nearest[i]);
+        float side = offsets[i].w;
+        if (side == 0) {
+            cells[i] = vec4(0, 0, 0, band);  // no surface nearby
+        } else if (d < MIN_FLOAT_DIFF) {
+            cells[i] = vec4(0, 0, 0, 0);  // right on the surface, no way to tell which way is out
+        } else {
+            cells[i] = vec4(vec3(offsets[i]) / d * side, d * side);
+        }
+    }
+}
+
+// Load the field cached at `path`, or bake it and save it there if there isn't one or it was baked from different inputs
+DistanceField* DistanceField::loadOrBake(const std::string& path, const std::vector<vec3>& triangles, Box bound) {
+    DistanceField* field = new DistanceField();
+    if (field->load(path, hashInputs(triangles, bound, DISTANCE_FIELD_CELL_SIZE))) return field;
+    delete field;
+
+    printf("Baking distance field from %zu triangles...\n", triangles.size() / 3);
+    field = new DistanceField(triangles, bound);
+    if (!field->save(path)) printf("Failed to save distance field to %s\n", path.c_str());
+    return field;
+}
+
+// Read a field saved by `save`. Fails if there is no file, or it wasn't baked from the inputs hashed into `expectedKey`
+bool DistanceField::load(const std::string& path, uint64_t expectedKey) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    DistanceFieldHeader h;
+    if (!file.read((char*)&h, sizeof(h))) return false;
+    if (h.magic != DISTANCE_FIELD_MAGIC || h.version != DISTANCE_FIELD_VERSION || h.key != expectedKey) return false;
+
+    dims = ivec3(h.dims[0], h.dims[1], h.dims[2]);
+    low = vec3(h.low[0], h.low[1], h.low[2]);
+    cellSize = h.cellSize;
+    band = h.band;
+    size = vec3(dims) * cellSize;
+    key = h.key;
+    cells.resize(dims.x * dims.y * dims.z);
+    if (!file.read((char*)cells.data(), cells.size() * sizeof(vec4))) {
+        printf("Distance field file %s is truncated\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool DistanceField::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    DistanceFieldHeader h = {DISTANCE_FIELD_MAGIC, DISTANCE_FIELD_VERSION, key, {dims.x, dims.y, dims.z}, {low.x, low.y, low.z}, cellSize, band};
+    file.write((const char*)&h, sizeof(h));
+    file.write((const char*)cells.data(), cells.size() * sizeof(vec4));
+    return file.good();
+}
+
+// Trilinearly sample the field at `p`, the same as a linearly filtered, edge clamped 3D texture
+vec4 DistanceField::sample(vec3 p) const {
+    vec3 f = clamp((p - low) / cellSize - 0.5f, vec3(0), vec3(dims - 1));
+    ivec3 i0 = ivec3(f);
+    ivec3 i1 = min(i0 + 1, dims - 1);
+    vec3 t = f - vec3(i0);
+
+    vec4 c00 = mix(cells[flatten(ivec3(i0.x, i0.y, i0.z))], cells[flatten(ivec3(i1.x, i0.y, i0.z))], t.x);
+    vec4 c10 = mix(cells[flatten(ivec3(i0.x, i1.y, i0.z))], cells[flatten(ivec3(i1.x, i1.y, i0.z))], t.x);
+    vec4 c01 = mix(cells[flatten(ivec3(i0.x, i0.y, i1.z))], cells[flatten(ivec3(i1.x, i0.y, i1.z))], t.x);
+    vec4 c11 = mix(cells[flatten(ivec3(i0.x, i1.y, i1.z))], cells[flatten(ivec3(i1.x, i1.y, i1.z))], t.x);
+    return mix(mix(c00, c10, t.y), mix(c01, c11, t.y), t.z);
+}
+
+// FNV-1a hash of everything a bake depends on
+uint64_t DistanceField::hashInputs(const std::vector<vec3>& triangles, Box bound, float cellSize) {
+    uint64_t h = 14695981039346656037ull;
+    auto add = [&h](const void* data, size_t bytes) {
+        const unsigned char* p = (const unsigned char*)data;
+        for (size_t i = 0; i < bytes; ++i) h = (h ^ p[i]) * 1099511628211ull;
+    };
+    add(triangles.data(), triangles.size() * sizeof(vec3));
+    add(&bound.low, sizeof(vec3));
+    add(&bound.high, sizeof(vec3));
+    add(&cellSize, sizeof(float));
+    unsigned version = DISTANCE_FIELD_VERSION;
+    add(&version, sizeof(version));
+    return h;
+}
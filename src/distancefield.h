@@ -0,0 +1,47 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "box.h"
+#include "sm.h"
+#include "util.h"
+
+#define DISTANCE_FIELD_CELL_SIZE 4  // width of a distance field cell
+#define DISTANCE_FIELD_BAND 3       // cells around each surface given an exact distance. further cells are all `band` away
+
+// Narrow band signed distance field of static geometry over a fixed region, so boids can steer around it with a single lookup.
+// Each cell holds the direction out of the nearest surface and the signed distance to it, negative inside the geometry.
+// Inside and outside are decided by the nearest triangle's winding, which is close enough for steering but can be wrong
+// right at sharp edges.
+// Baking is O(cells near each triangle), so the result is cached to a file and only rebaked when the geometry changes.
+class DistanceField {
+   public:
+    DistanceField() {}
+    DistanceField(const std::vector<vec3>& triangles, Box bound, float _cellSize = DISTANCE_FIELD_CELL_SIZE);
+
+    static DistanceField* loadOrBake(const std::string& path, const std::vector<vec3>& triangles, Box bound);
+    bool load(const std::string& path, uint64_t expectedKey);
+    bool save(const std::string& path) const;
+
+    vec4 sample(vec3 p) const;
+
+    std::vector<vec4> cells;  // indexed by `flatten`. xyz is the direction away from the nearest surface, w the signed distance to it
+    vec3 low = vec3(0);       // corner of the first cell
+    vec3 size = vec3(0);      // size of the whole field, `dims * cellSize`
+    ivec3 dims = ivec3(1);    // number of cells along each axis
+    float cellSize = 1;
+    float band = 0;           // distance held by cells away from every surface
+    uint64_t key = 0;         // hash of the triangles and grid the field was baked from
+
+    float avoidRange = 6;   // distance from geometry at which boids start steering away
+    float avoidWeight = 2;  // how hard boids steer away, per unit inside `avoidRange`
+
+   private:
+    static uint64_t hashInputs(const std::vector<vec3>& triangles, Box bound, float cellSize);
+    unsigned flatten(ivec3 c) const { return c.x + dims.x * (c.y + dims.y * c.z); }
+};
+
+#endif /* DISTANCEFIELD_H */
@@ -2,35 +2,47 @@
 #define FLOCK_H
 
 #define DISPATCH_SIZE 1024
+#define QUERY_SCRATCH_SIZE MAX_CHECK              // size of each thread's neighbour list on the cpu
+#define OCTREE_REBUILD_INTERVAL 60               // steps between full octree rebuilds on the cpu
+#define MAX_LIST_NEIGHBOURS 128                  // size of each boid's neighbour list, when neighbour lists are used
+#define LIST_OVERFLOW (MAX_LIST_NEIGHBOURS + 1)  // list length of a boid with more neighbours than fit in its list
+#define REORDER_INTERVAL 300                     // steps between sorting boids into spatial (Morton) order
+#define OBSTACLE_TEXTURE_UNIT 31                 // texture unit of the obstacle distance field. must match boids.comp
+
+// grid.comp stages
+#define GRID_STAGE_COUNT 0
+#define GRID_STAGE_SCAN 1
+#define GRID_STAGE_SCATTER 2
 
 #include "box.h"
 #include "boid.h"
 #include "boidinfo.h"
+#include "boidkernel.h"
+#include "distancefield.h"
+#include "grid.h"
+#include "homegrid.h"
 #include "octree.h"
+#include "threadpool.h"
+#ifndef HEADLESS
 #include "variantmesh.h"
+#endif
 
 using namespace BoidInfo;
 
 class Flock {
    public:
-    Flock(VariantMesh* _vmesh, std::vector<vec3> homes_) {
-        vmesh = _vmesh;
+    // Create `n` boids of each type in `counts`, in order. Nothing is set up for drawing them, see the VariantMesh constructor for that
+    Flock(const std::vector<std::pair<BoidType, int>>& counts, std::vector<vec3> homes_) {
         int spread = WORLD_BOUND_HIGH / 16;
         int id = 0;
         bc = new BoidContainer();
-        bc->boids = new Boid*[vmesh->totalInstanceCount];
-        boid_count = bc->size = vmesh->totalInstanceCount;
-        for (auto v : vmesh->variants) {
-            BoidType type = getTypeFromModel(v->path);
-            for (int i = 0; i < v->instanceCount; ++i) {
+        for (auto [type, n] : counts) boid_count += n;
+        bc->reserve(boid_count);
+        for (auto [type, n] : counts) {
+            for (int i = 0; i < n; ++i) {
                 vec3 pos = Util::randomv(-spread / 2, spread / 2);
                 vec3 vel = Util::randomv(-5, 5);
-                Boid* boid = new Boid(
-                    pos,
-                    vel,
-                    type,
-                    id);
-                bc->boids[id] = boid;
+                bc->add(pos, vel, type);
                 BoidS bs = BoidInfo::createBoidStruct(type, id, pos, vel);
                 boid_structs.push_back(bs);
                 transforms.push_back(translate(mat4(1), pos));
@@ -38,29 +50,89 @@ class Flock {
             }
         }
 
+        // boids gather at a point above and between each home and the centre of the level
+        std::vector<vec3> homePoints;
         for (auto h : homes_) {
             if (abs(h.x) >= WORLD_BOUND_HIGH * 2 || abs(h.y) >= WORLD_BOUND_HIGH * 2 || abs(h.z) >= WORLD_BOUND_HIGH * 2) continue;
-            cs_homes.push_back(vec4(h, 0));
+            homePoints.push_back(h / 2.f + vec3(0, 5, 0));
+            cs_homes.push_back(vec4(homePoints.back(), 0));
         }
+        homeGrid = new HomeGrid(homePoints, *SM::sceneBox);
 
 #ifdef TREE
         tree = new Octree(bc, *SM::sceneBox);
-#else
+        float maxRange = 0;
+        for (int i = 0; i < boid_count; ++i) maxRange = std::max(maxRange, bc->traits[i].visibleRange);
+        // boids are kept inside the level bounds, so the grid only needs to cover those. any stragglers go in the border cells
+        grid = new Grid(bc, Box(vec3(WORLD_BOUND_LOW), vec3(WORLD_BOUND_HIGH)), maxRange);
+        pool = new ThreadPool();
+        queryScratch.resize(pool->size() * QUERY_SCRATCH_SIZE);
+        neighbourLists.resize(boid_count * MAX_LIST_NEIGHBOURS);
+        listCounts.resize(boid_count);
+        listOrigins.resize(boid_count);
+        prevTransforms = transforms;
+        drawTransforms = transforms;
+#endif
+    }
+
+#ifndef HEADLESS
+    Flock(VariantMesh* _vmesh, std::vector<vec3> homes_) : Flock(getVariantCounts(_vmesh), homes_) {
+        vmesh = _vmesh;
+#ifndef TREE
         // create and bind ssbos to vmesh
         boidShader = new Shader("boid shader", PROJDIR "Shaders/boids.comp");
         glBindVertexArray(vmesh->VAO);
-        glCreateBuffers(1, &BSBO);
+        glCreateBuffers(2, BSBO);
         glCreateBuffers(1, &HLBO);
-        glCreateBuffers(1, &BTBO);
+        glCreateBuffers(3, BTBO);
         auto bufflag = GL_MAP_WRITE_BIT | GL_MAP_READ_BIT;
-        glNamedBufferStorage(BSBO, boid_structs.size() * sizeof(BoidS), boid_structs.data(), bufflag);
+        for (int i = 0; i < 2; ++i) glNamedBufferStorage(BSBO[i], boid_structs.size() * sizeof(BoidS), boid_structs.data(), bufflag | GL_DYNAMIC_STORAGE_BIT);
+        std::vector<InstanceS> instances(boid_count);
+        for (int i = 0; i < boid_count; ++i) {
+            instances[i] = {vec4(vec3(boid_structs[i].pos) * 2.f, boidParams[boid_structs[i].type].scale), vec4(0, 0, 0, 1)};
+        }
+        for (int i = 0; i < 3; ++i) glNamedBufferStorage(BTBO[i], instances.size() * sizeof(InstanceS), instances.data(), bufflag);
         glNamedBufferStorage(HLBO, cs_homes.size() * sizeof(vec4), cs_homes.data(), bufflag);
-        glNamedBufferStorage(BTBO, transforms.size() * sizeof(mat4), transforms.data(), bufflag);
+        glCreateBuffers(1, &HCBO);
+        glNamedBufferStorage(HCBO, homeGrid->cells.size() * sizeof(HomeCell), homeGrid->cells.data(), 0);
         glBindVertexArray(0);
+
+        // spatial grid. bucket count is a power of two with roughly two buckets per boid, and at least one per scan thread
+        gridShader = new Shader("grid shader", PROJDIR "Shaders/grid.comp");
+        gridTableSize = DISPATCH_SIZE;
+        while (gridTableSize < boid_count * 2) gridTableSize <<= 1;
+        glCreateBuffers(1, &SIBO);
+        glCreateBuffers(1, &CCBO);
+        glCreateBuffers(1, &CRBO);
+        glCreateBuffers(1, &BCBO);
+        glNamedBufferStorage(SIBO, boid_count * sizeof(unsigned), nullptr, 0);
+        glNamedBufferStorage(CCBO, gridTableSize * sizeof(unsigned), nullptr, 0);
+        glNamedBufferStorage(CRBO, gridTableSize * sizeof(uvec2), nullptr, 0);
+        glNamedBufferStorage(BCBO, boid_count * sizeof(uvec2), nullptr, 0);
+
+        // neighbour lists
+        glCreateBuffers(1, &NLBO);
+        glCreateBuffers(1, &NCBO);
+        glNamedBufferStorage(NLBO, boid_count * MAX_LIST_NEIGHBOURS * sizeof(unsigned), nullptr, 0);
+        glNamedBufferStorage(NCBO, boid_count * sizeof(unsigned), nullptr, 0);
+
+        // per-type parameters, shared by every boid of that type
+        for (int t = 0; t < NUM_BOID_TYPES; ++t) type_structs[t] = BoidInfo::createBoidTypeStruct((BoidType)t);
+        glCreateBuffers(1, &BTPBO);
+        glNamedBufferStorage(BTPBO, sizeof(type_structs), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        updateTypeParams();
 #endif
     }
 
-    BoidType getTypeFromModel(std::string nm) {
+    // boid type and instance count of each variant, in the order the variants are drawn
+    static std::vector<std::pair<BoidType, int>> getVariantCounts(VariantMesh* vm) {
+        std::vector<std::pair<BoidType, int>> counts;
+        for (auto v : vm->variants) counts.push_back({getTypeFromModel(v->path), v->instanceCount});
+        return counts;
+    }
+#endif
+
+    static BoidType getTypeFromModel(std::string nm) {
         auto pth = MODEL_NO_DIR(nm);
         if (pth == "fish_threadfin") {
             return BoidType::F_THREADFIN;
@@ -88,47 +160,311 @@ class Flock {
         return BoidType::F_THREADFIN;
     }
 
-    // Process all boids in the flock. Only boids within a sphere at `updateCentre` with radius `updateDist` are updated.
+    // Give the flock static geometry to steer around. `field` is kept, not copied
+    void setObstacles(DistanceField* field) {
+        obstacles = field;
+#ifndef TREE
+        if (obstacleTexture) glDeleteTextures(1, &obstacleTexture);  // texture storage can't be resized
+        glCreateTextures(GL_TEXTURE_3D, 1, &obstacleTexture);
+        ivec3 d = field->dims;
+        glTextureStorage3D(obstacleTexture, 1, GL_RGBA16F, d.x, d.y, d.z);
+        glTextureSubImage3D(obstacleTexture, 0, 0, 0, 0, d.x, d.y, d.z, GL_RGBA, GL_FLOAT, field->cells.data());
+        glTextureParameteri(obstacleTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(obstacleTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(obstacleTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(obstacleTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(obstacleTexture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+#endif
+    }
+
+    // Step all boids in the flock forward by `SM::simStep`. Only boids within a sphere at `updateCentre` with radius `updateDist` are updated.
     void process(vec3 updateCentre, float updateDist) {
+#ifndef TREE
+        // the last step's writes have to be visible to this step and to the draw of its transforms. waiting here instead of
+        // straight after the dispatch lets the last step run on the gpu while the cpu gets on with the frame
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+#endif
+        if (reorderBoids && reorderSteps++ % REORDER_INTERVAL == 0) reorder();
 #ifdef TREE
-        tree->reset();
-        for (int i = 0; i < bc->size; ++i) {
-            tree->insert(bc->boids[i]);
-        }
-        for (int i = 0; i < bc->size; ++i) {
-            flockBoid(bc->boids[i]);
-            transforms[i] = scale(Util::lookTowards(bc->boids[i]->pos, bc->boids[i]->dir), BoidInfo::getBoidScale(bc->boids[i]->type));
+        if (useListsThisStep()) {
+            updateNeighbourLists();
+        } else {
+            listsValid = false;
+            buildIndex();
         }
+        // every boid reads the current state and writes the next, so they can all be updated at once
+        transforms.swap(prevTransforms);
+        pool->parallelFor(bc->size, 64, [this](unsigned begin, unsigned end, unsigned thread) {
+            unsigned* scratch = &queryScratch[thread * QUERY_SCRATCH_SIZE];
+            unsigned long long found = 0;
+            for (unsigned i = begin; i < end; ++i) {
+                found += flockBoid(i, scratch);
+                transforms[bc->ids[i]] = scale(Util::lookTowards(bc->nextPos[i], bc->dir[i]), BoidInfo::getBoidScale(bc->type[i]));
+            }
+            neighboursFound += found;
+        });
+        bc->swap();
 #else
         glBindVertexArray(vmesh->VAO);
+        // boids can't move faster than the fastest type's max speed, so lists are rebuilt once the distance that could
+        // have been covered since the last build passes half the skin
+        bool buildLists = false;
+        if (useNeighbourLists) {
+            listTravel += maxBoidSpeed * speedFactor * SM::simStep;
+            buildLists = !listsValid || resetFlag || listSkin != neighbourSkin || listTravel > neighbourSkin / 2;
+        } else {
+            listsValid = false;
+        }
+        if (useGrid && (!useNeighbourLists || buildLists)) buildGrid();
         boidShader->use();
-        boidShader->setFloat("deltaTime", SM::delta);
+        boidShader->setFloat("deltaTime", SM::simStep);
         boidShader->setBool("canAttack", SM::canBoidsAttack);
         boidShader->setVec3("gridSize", vec3(levelDistance));
         boidShader->setVec3("updateCentre", updateCentre);
         boidShader->setFloat("updateDistance", updateDist);
+        boidShader->setBool("useLOD", useLOD);
+        boidShader->setVec3("lodRanges", lodRanges * updateDist);
+        boidShader->setInt("stepIndex", simSteps++);
         boidShader->setFloat("globalSpeedFactor", speedFactor);
         boidShader->setBool("resetFlag", resetFlag);
+        boidShader->setFloat("visibleRange", visibleRange);
+        boidShader->setBool("useGrid", useGrid);
+        boidShader->setBool("useTiles", useTiles);
+        boidShader->setInt("gridTableSize", gridTableSize);
+        boidShader->setFloat("cellSize", gridCellSize());
+        boidShader->setBool("useNeighbourList", useNeighbourLists);
+        boidShader->setFloat("listRange", visibleRange + neighbourSkin);
+        boidShader->setInt("maxListNeighbours", MAX_LIST_NEIGHBOURS);
+        boidShader->setVec3("homeGridLow", homeGrid->box.low);
+        boidShader->setVec3("homeGridDims", vec3(homeGrid->dims));
+        boidShader->setFloat("homeCellSize", homeGrid->cellSize);
+        boidShader->setBool("useObstacles", useObstacles && obstacles);
+        if (obstacles) {
+            boidShader->setVec3("obstacleLow", obstacles->low);
+            boidShader->setVec3("obstacleSize", obstacles->size);
+            boidShader->setFloat("obstacleRange", obstacles->avoidRange);
+            boidShader->setFloat("obstacleWeight", obstacles->avoidWeight);
+            glBindTextureUnit(OBSTACLE_TEXTURE_UNIT, obstacleTexture);
+        }
         resetFlag = false;
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, BSBO);
+        // read the current state and write the next one, along with its transforms
+        int next = 1 - currentBuffer;
+        int nextTransforms = (transformHead + 1) % 3;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, BSBO[currentBuffer]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, BSBO[next]);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, HLBO);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, BTBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, SIBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, BTBO[nextTransforms]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, CRBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, NLBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, NCBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, BTPBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, HCBO);
 
         int n = transforms.size();
+        if (buildLists) {
+            boidShader->setBool("buildNeighbourList", true);
+            glDispatchCompute(ceil(n / DISPATCH_SIZE + 1), 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);  // the lists are read by the step below
+            listsValid = true;
+            listTravel = 0;
+            listSkin = neighbourSkin;
+        }
+        boidShader->setBool("buildNeighbourList", false);
         glDispatchCompute(ceil(n / DISPATCH_SIZE + 1), 1, 1);  // declare work group sizes and run compute shader
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);        // wait for all threads to be finished
+        currentBuffer = next;
+        transformHead = nextTransforms;
 #endif
     }
 
-    void flockBoid(Boid* b) {
+#ifndef TREE
+    // Sort boid indices by spatial grid cell, so boids.comp only has to check the 27 cells around each boid instead of every boid.
+    // Cells are `gridCellSize()` wide and hashed into `gridTableSize` buckets, so the grid is unbounded.
+    void buildGrid() {
+        int n = boid_count;
+        glClearNamedBufferData(CCBO, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        gridShader->use();
+        gridShader->setFloat("cellSize", gridCellSize());
+        gridShader->setInt("tableSize", gridTableSize);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, BSBO[currentBuffer]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, SIBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, CCBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, CRBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, BCBO);
+
+        // count boids per bucket
+        gridShader->setInt("stage", GRID_STAGE_COUNT);
+        glDispatchCompute(ceil(n / DISPATCH_SIZE + 1), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // prefix sum bucket counts into ranges
+        gridShader->setInt("stage", GRID_STAGE_SCAN);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // scatter boid indices into their bucket's range
+        gridShader->setInt("stage", GRID_STAGE_SCATTER);
+        glDispatchCompute(ceil(n / DISPATCH_SIZE + 1), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Upload `type_structs` after changing them. Much cheaper than changing every boid of a type
+    void updateTypeParams() {
+        glNamedBufferSubData(BTPBO, 0, sizeof(type_structs), type_structs);
+        maxBoidSpeed = 0;
+        for (int t = 0; t < NUM_BOID_TYPES; ++t) maxBoidSpeed = std::max(maxBoidSpeed, type_structs[t].max_speed);
+        listsValid = false;
+    }
+
+    // neighbour lists need a bigger search radius, so every boid within the skin is in the 27 cells around it
+    float gridCellSize() {
+        return useNeighbourLists ? visibleRange + neighbourSkin : visibleRange;
+    }
+#endif
+
+    // Sort the boids by the Morton code of their position, so boids that are close together in space are close together
+    // in memory too. Neighbour loops then mostly touch memory that's already cached (cpu) or coalesced (gpu).
+    // Anything indexed by slot is invalidated.
+    void reorder() {
+        vec3 low = SM::sceneBox->low;
+        vec3 high = SM::sceneBox->high;
+#ifdef TREE
+        bc->reorder(Util::mortonOrder(bc->pos.data(), bc->size, low, high));
+        grid->invalidate();
+        treeSteps = 0;
+#else
+        // boids.comp writes each boid's transform at its ID, so the order of the boid structs doesn't matter to rendering
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glGetNamedBufferSubData(BSBO[currentBuffer], 0, boid_count * sizeof(BoidS), boid_structs.data());
+        std::vector<vec3> positions(boid_count);
+        for (int i = 0; i < boid_count; ++i) positions[i] = vec3(boid_structs[i].pos);
+        auto order = Util::mortonOrder(positions.data(), boid_count, low, high);
+        std::vector<BoidS> sorted(boid_count);
+        for (int i = 0; i < boid_count; ++i) sorted[i] = boid_structs[order[i]];
+        boid_structs.swap(sorted);
+        glNamedBufferSubData(BSBO[currentBuffer], 0, boid_count * sizeof(BoidS), boid_structs.data());
+#endif
+        listsValid = false;
+    }
+
+#ifdef TREE
+    // neighbour lists don't apply to topological neighbours, which have no fixed radius
+    bool useListsThisStep() {
+        return useNeighbourLists && (useGrid || !topologicalNeighbours);
+    }
+
+    void buildIndex() {
+        // only boids that left their cell or node are moved, with a full octree rebuild every so often to keep it balanced
+        if (useGrid) {
+            grid->build();
+            treeSteps = 0;
+        } else if (treeSteps++ % OCTREE_REBUILD_INTERVAL == 0) {
+            tree->build();
+        } else {
+            tree->update();
+        }
+    }
+
+    // Rebuild every boid's neighbour list if any boid has moved more than half the skin since the lists were built.
+    // Until then, no two boids can have come from outside `visibleRange + neighbourSkin` to inside `visibleRange`
+    // of each other, so the lists still hold every neighbour.
+    // Boids with more neighbours than fit in a list are marked with LIST_OVERFLOW and search the index directly instead
+    void updateNeighbourLists() {
+        bool stale = !listsValid || listSkin != neighbourSkin;
+        float limit = neighbourSkin * neighbourSkin / 4;
+        for (unsigned i = 0; i < bc->size && !stale; ++i) {
+            stale = Util::sqDist(bc->pos[i], listOrigins[i]) > limit;
+        }
+        if (!stale) return;
+
+        buildIndex();
+        pool->parallelFor(bc->size, 64, [this](unsigned begin, unsigned end, unsigned thread) {
+            // query one more than a list holds, so a full list can be told apart from an overflowing one
+            std::span<unsigned> out(&queryScratch[thread * QUERY_SCRATCH_SIZE], MAX_LIST_NEIGHBOURS + 1);
+            for (unsigned i = begin; i < end; ++i) {
+                vec3 pos = bc->pos[i];
+                float range = bc->traits[i].visibleRange + neighbourSkin;
+                int cnt = useGrid ? grid->getBoidsInRange(pos, range, out) : tree->getBoidsInRange(pos, range, out);
+                std::copy_n(out.begin(), std::min(cnt, MAX_LIST_NEIGHBOURS), &neighbourLists[i * MAX_LIST_NEIGHBOURS]);
+                listCounts[i] = cnt;  // LIST_OVERFLOW if it didn't fit
+                listOrigins[i] = pos;
+            }
+        });
+        listsValid = true;
+        listSkin = neighbourSkin;
+    }
+#endif
+
+    // Update a single boid and return how many neighbours it found. `scratch` holds the neighbour list, and must have room
+    // for QUERY_SCRATCH_SIZE indices
+    int flockBoid(unsigned id, unsigned* scratch) {
+        vec3 pos = bc->pos[id];
+        float range = bc->traits[id].visibleRange;
+        std::span<unsigned> out(scratch, QUERY_SCRATCH_SIZE);
         int cnt = 0;
-        const unsigned* bs = tree->getBoidsInRange(b->pos, b->visibleRange, cnt);
-        b->process(bc, bs, cnt, homes);
+#ifdef TREE
+        if (useListsThisStep() && listCounts[id] != LIST_OVERFLOW) {
+            // lists hold every boid within the skin, only keep the ones actually in range
+            const unsigned* list = &neighbourLists[id * MAX_LIST_NEIGHBOURS];
+            float dist = range * range;
+            for (unsigned i = 0; i < listCounts[id]; ++i) {
+                if (Util::sqDist(bc->pos[list[i]], pos) <= dist) scratch[cnt++] = list[i];
+            }
+        } else if (useListsThisStep()) {
+            // the list overflowed. the index is only rebuilt with the lists, so boids can be filed up to half the skin away
+            // from where they are now. search that much further, then only keep the ones actually in range
+            float wide = range + listSkin / 2;
+            int found = useGrid ? grid->getBoidsInRange(pos, wide, out) : tree->getBoidsInRange(pos, wide, out);
+            float dist = range * range;
+            for (int i = 0; i < found; ++i) {
+                if (Util::sqDist(bc->pos[scratch[i]], pos) <= dist) scratch[cnt++] = scratch[i];
+            }
+        } else
+#endif
+        if (useGrid && splitTypeQueries) {
+            // the kernel ignores boids that aren't family, predators or prey, so they're never looked at. predators and
+            // prey are searched out to the intercept distance if that's further than the boid can see
+            BoidType type = bc->type[id];
+            unsigned relations = SM::canBoidsAttack ? relationMask(type) : 0;
+            if (getBoidInterceptDistance(type) <= range) {
+                cnt = grid->getBoidsInRange(pos, range, typeBit(type) | relations, out);
+            } else {
+                cnt = grid->getBoidsInRange(pos, range, typeBit(type), out);
+                if (relations) cnt += grid->getBoidsInRange(pos, getBoidInterceptDistance(type), relations, out.subspan(cnt));
+            }
+        } else if (useGrid) {
+            cnt = grid->getBoidsInRange(pos, range, out);
+        } else if (topologicalNeighbours) {
+            cnt = tree->getNearest(pos, numTopological, range, id, out);
+        } else {
+            cnt = tree->getBoidsInRange(pos, range, out);
+        }
+        Boid(bc, id).process(scratch, cnt, *homeGrid, useObstacles ? obstacles : nullptr);
+        return cnt;
     }
 
-    void show() {
-        vmesh->render();
+#ifndef HEADLESS
+    // Draw the flock `alpha` of the way between its last two states
+    void show(float alpha) {
+#ifdef TREE
+        ProfileScope scope("Flock Draw");
+        for (int i = 0; i < boid_count; ++i) drawTransforms[i] = prevTransforms[i] + (transforms[i] - prevTransforms[i]) * alpha;
+        vmesh->render(drawTransforms.data());
+#else
+        // draw the two steps before the one that was just dispatched, so the draw doesn't wait on it. the newest of them
+        // went into the buffer just before `transformHead`
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, BTBO[(transformHead + 2) % 3]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, BTBO[(transformHead + 1) % 3]);
+        // fog only covers boids when the camera is under the sea, see variantMesh.frag
+        float fogDistance = SM::camera->pos.y < SM::seaLevel ? SM::fogBounds.y : SM::camera->farClipDist;
+        SM::profiler->begin("Flock Cull");
+        vmesh->cull(SM::camera->getViewMatrix(), SM::camera->getProjectionMatrix(), SM::camera->pos, fogDistance, alpha, useCulling, useMeshLOD);
+        vmesh->shader->use();
+        vmesh->shader->setFloat("transformAlpha", alpha);
+        vmesh->render();  // times anim.comp and the draw itself
+#endif
     }
+#endif
 
     void reset() {
 #ifdef TREE
@@ -136,11 +472,11 @@ class Flock {
         for (int i = 0; i < boid_count; ++i) {
             vec3 np = Util::randomv(-spread / 2, spread / 2);
             vec3 nv = normalize(Util::randomv(-5, 5));
-            Boid* b = bc->boids[i];
-            b->pos = np;
-            b->resetVelocity();
+            bc->pos[i] = np;
+            bc->velocity[i] = nv;
         }
-        tree->reset();
+        treeSteps = 0;
+        listsValid = false;
 #else
         resetFlag = true;
 #endif
@@ -151,20 +487,67 @@ class Flock {
     BoidContainer* bc;
     Box region;
     Octree* tree;
+    Grid* grid;
+    ThreadPool* pool;
+    std::vector<unsigned> queryScratch;  // neighbour lists, one per thread
+    std::vector<unsigned> neighbourLists;  // every boid within `visibleRange + neighbourSkin` of each boid, MAX_LIST_NEIGHBOURS per boid
+    std::vector<unsigned> listCounts;      // length of each boid's neighbour list
+    std::vector<vec3> listOrigins;         // position of each boid when its list was built
+    std::atomic<unsigned long long> neighboursFound = 0;  // neighbours found by every boid over every step so far (cpu)
     std::vector<BoidS> boid_structs;
+    BoidTypeS type_structs[NUM_BOID_TYPES];  // indexed by BoidType (gpu)
     std::vector<mat4> transforms;
+    std::vector<mat4> prevTransforms;  // transforms from the step before `transforms` (cpu)
+    std::vector<mat4> drawTransforms;  // transforms interpolated between the two for drawing (cpu)
+#ifndef HEADLESS
     VariantMesh* vmesh;
     Shader* boidShader;
+    Shader* gridShader;
+#endif
     std::vector<vec4> cs_homes;
-    std::vector<vec3> homes = {vec3(0, 10, 0), vec3(0, -10, 0), vec3(10)};
+    HomeGrid* homeGrid;  // nearest home lookup, shared by every boid
+    DistanceField* obstacles = nullptr;  // static geometry to steer around, if any
+    bool useObstacles = true;
     int boid_count = 0;
     float speedFactor = 1;
     float levelDistance = WORLD_BOUND_HIGH;
     bool resetFlag = false;
+    bool useGrid = true;       // use the spatial grid for neighbour search instead of the octree (cpu) or brute force (gpu)
+    bool useTiles = true;      // brute force through shared memory tiles instead of reading every boid per boid (gpu)
+    bool splitTypeQueries = true;  // search the grid for family, then predators and prey, skipping every other type (cpu)
+    bool topologicalNeighbours = false;  // only flock with the closest `numTopological` boids in range (cpu octree only)
+    int numTopological = 7;
+    unsigned treeSteps = 0;  // steps since the octree was last rebuilt
+    bool reorderBoids = true;  // periodically sort boid storage into spatial order
+    unsigned reorderSteps = 0;
+    bool useNeighbourLists = false;  // reuse neighbour lists over several steps, until a boid may have moved past the skin
+    float neighbourSkin = 2;         // extra radius searched when building neighbour lists
+    bool listsValid = false;
+    float listSkin = 0;              // skin the lists were built with
+    float listTravel = 0;            // furthest any boid could have moved since the lists were built (gpu)
+    float maxBoidSpeed = 0;          // largest max speed of any boid type (gpu)
+    float visibleRange = 8;    // neighbour search radius on the gpu. also the grid cell size
+    bool useLOD = true;                // update boids past the update distance every 2nd/4th/8th step, instead of freezing them (gpu)
+    vec3 lodRanges = vec3(1.5, 2, 3);  // outer edge of each of those tiers, as a multiple of the update distance. boids past the last only drift
+    unsigned simSteps = 0;             // steps taken so far
+    bool useCulling = true;            // only draw boids inside the camera frustum and in front of the fog (gpu)
+    bool useMeshLOD = true;            // draw boids that are small on screen with simplified meshes (gpu)
+    int gridTableSize = 0;     // number of buckets in the spatial grid
+    int currentBuffer = 0;     // BSBO holding the latest state
+    int transformHead = 0;     // BTBO written by the latest step
 
-    unsigned int BSBO;  // boid structs
-    unsigned int HLBO;  // home locations
-    unsigned int BTBO;  // boid transforms
+    unsigned int BSBO[2];  // boid structs. one holds the current state, the other is written with the next
+    unsigned int HLBO;     // home locations
+    unsigned int HCBO;     // home grid cells
+    unsigned int BTBO[3];  // boid transforms. one per step for the last three steps, so the last two can be drawn while the newest is written
+    unsigned int SIBO;  // boid indices sorted by grid bucket
+    unsigned int CCBO;  // grid bucket counts
+    unsigned int CRBO;  // grid bucket ranges in SIBO
+    unsigned int BCBO;  // grid bucket of each boid, and its rank inside that bucket
+    unsigned int NLBO;  // neighbour lists
+    unsigned int NCBO;  // neighbour list lengths
+    unsigned int BTPBO;  // boid type parameters
+    unsigned int obstacleTexture = 0;  // `obstacles`, as a 3D texture
 };
 
 #endif /* FLOCK_H */
@@ -0,0 +1,113 @@
+#include "grid.h"
+
+Grid::Grid(BoidContainer*& cnt, Box bound, float _cellSize) : bc(cnt), box(bound), cellSize(_cellSize) {
+    dims = ivec3(max(ceil(box.size / cellSize), vec3(1)));
+    unsigned numBuckets = dims.x * dims.y * dims.z * NUM_BOID_TYPES;
+    cellStart.resize(numBuckets + 1);
+    cellCursor.resize(numBuckets);
+    boidCell.resize(bc->size);
+    sorted.resize(bc->size);
+    sortedBits.resize(bc->size);
+}
+
+// get the (clamped) cell containing `p`
+ivec3 Grid::getCell(vec3 p) {
+    // clamp before converting so far away (or nan) positions can't overflow
+    vec3 c = floor((p - box.low) / cellSize);
+    return ivec3(clamp(c, vec3(0), vec3(dims - 1)));
+}
+
+// Sort all boids into their cells, and return how many boids changed cell since the last build.
+// Queries read positions straight from the container, so if no boid changed cell the sort is skipped.
+unsigned Grid::build() {
+    unsigned moved = 0;
+    for (unsigned i = 0; i < bc->size; ++i) {
+        unsigned c = flatten(getCell(bc->pos[i])) * NUM_BOID_TYPES + bc->type[i];
+        moved += c != boidCell[i];
+        boidCell[i] = c;
+    }
+    if (built && moved == 0) return 0;
+    built = true;
+
+    // count boids per bucket, offset by one so the prefix sum below gives each bucket's start
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    for (unsigned i = 0; i < bc->size; ++i) {
+        cellStart[boidCell[i] + 1]++;
+    }
+    for (unsigned c = 1; c < cellStart.size(); ++c) {
+        cellStart[c] += cellStart[c - 1];
+    }
+
+    // scatter
+    std::copy(cellStart.begin(), cellStart.end() - 1, cellCursor.begin());
+    for (unsigned i = 0; i < bc->size; ++i) {
+        unsigned at = cellCursor[boidCell[i]]++;
+        sorted[at] = i;
+        sortedBits[at] = BoidInfo::typeBit(bc->type[i]);
+    }
+    return moved;
+}
+
+// Write the indices of boids within the radius `range` around `origin` into `out`, and return how many were written.
+// At most `out.size()` boids are returned.
+int Grid::getBoidsInRange(vec3 origin, float range, std::span<unsigned> out) {
+    int count = 0;
+    float dist = range * range;
+    ivec3 lo = getCell(origin - vec3(range));
+    ivec3 hi = getCell(origin + vec3(range));
+    for (int z = lo.z; z <= hi.z; ++z) {
+        for (int y = lo.y; y <= hi.y; ++y) {
+            // cells along x are contiguous, so each row is one range in `sorted`
+            unsigned row = flatten(ivec3(0, y, z));
+            unsigned end = cellStart[(row + hi.x + 1) * NUM_BOID_TYPES];
+            for (unsigned i = cellStart[(row + lo.x) * NUM_BOID_TYPES]; i < end && count < out.size(); ++i) {
+                unsigned idx = sorted[i];
+                if (Util::sqDist(bc->pos[idx], origin) <= dist) {
+                    out[count++] = idx;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Same as above, but only for boids whose type is in `typeMask` (see `BoidInfo::typeBit`).
+// Sparse rows are scanned whole with the mask as a filter, since reading a bucket's bounds costs about as much as testing a
+// few boids. In dense rows only the buckets of the masked types are read, so schools of other types are never touched.
+int Grid::getBoidsInRange(vec3 origin, float range, unsigned typeMask, std::span<unsigned> out) {
+    int count = 0;
+    float dist = range * range;
+    ivec3 lo = getCell(origin - vec3(range));
+    ivec3 hi = getCell(origin + vec3(range));
+    unsigned rowProbes = (hi.x - lo.x + 1) * std::popcount(typeMask);
+    for (int z = lo.z; z <= hi.z; ++z) {
+        for (int y = lo.y; y <= hi.y; ++y) {
+            unsigned row = flatten(ivec3(0, y, z));
+            unsigned first = (row + lo.x) * NUM_BOID_TYPES;
+            unsigned last = (row + hi.x + 1) * NUM_BOID_TYPES;
+            unsigned end = cellStart[last];
+            if (end - cellStart[first] <= rowProbes * GRID_BUCKET_COST) {
+                // types are mixed along the row, so the test is branchless to keep it from being mispredicted
+                for (unsigned i = cellStart[first]; i < end && count < out.size(); ++i) {
+                    unsigned idx = sorted[i];
+                    out[count] = idx;
+                    count += ((sortedBits[i] & typeMask) != 0) & (Util::sqDist(bc->pos[idx], origin) <= dist);
+                }
+                continue;
+            }
+            for (unsigned cell = first; cell < last; cell += NUM_BOID_TYPES) {
+                for (unsigned types = typeMask; types; types &= types - 1) {
+                    unsigned bucket = cell + std::countr_zero(types);
+                    unsigned bucketEnd = cellStart[bucket + 1];
+                    for (unsigned i = cellStart[bucket]; i < bucketEnd && count < out.size(); ++i) {
+                        unsigned idx = sorted[i];
+                        if (Util::sqDist(bc->pos[idx], origin) <= dist) {
+                            out[count++] = idx;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,47 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <bit>
+#include <span>
+#include <vector>
+
+#include "boid.h"
+#include "box.h"
+#include "sm.h"
+#include "util.h"
+
+#define GRID_BUCKET_COST 4  // roughly how many boids can be filtered in the time it takes to look up one bucket
+
+// Uniform grid over a fixed region, rebuilt every frame with a counting sort.
+// Boids are stored as contiguous index ranges per cell, so building is O(n) and does not allocate after construction.
+// Inside each cell, boids are sorted by type, so queries can look at only the types they care about.
+// Boids outside the region are clamped into the border cells, so queries are still correct, just slower out there.
+class Grid {
+   public:
+    Grid() {}
+    Grid(BoidContainer*& cnt, Box bound, float _cellSize);
+
+    unsigned build();
+    void invalidate() { built = false; }  // force the next build to sort, e.g. after the boids were reordered
+    int getBoidsInRange(vec3 origin, float range, std::span<unsigned> out);
+    int getBoidsInRange(vec3 origin, float range, unsigned typeMask, std::span<unsigned> out);
+
+    BoidContainer* bc;
+    Box box;
+    float cellSize = 1;
+    ivec3 dims = ivec3(1);  // number of cells along each axis
+
+   private:
+    ivec3 getCell(vec3 p);
+    unsigned flatten(ivec3 c) { return c.x + dims.x * (c.y + dims.y * c.z); }
+
+    // buckets are cells split by boid type. bucket `b` of cell `c` is `c * NUM_BOID_TYPES + b`
+    std::vector<unsigned> cellStart;   // start of each bucket's range in `sorted`. bucket `b` spans [cellStart[b], cellStart[b + 1])
+    std::vector<unsigned> cellCursor;  // write position of each bucket while scattering
+    std::vector<unsigned> boidCell;    // bucket of each boid from the last build
+    std::vector<unsigned> sorted;      // boid indices sorted by cell
+    std::vector<unsigned> sortedBits;  // `BoidInfo::typeBit` of each boid in `sorted`, so sparse rows can be filtered in order
+    bool built = false;
+};
+
+#endif /* GRID_H */
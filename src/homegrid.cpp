@@ -0,0 +1,36 @@
+#include "homegrid.h"
+
+HomeGrid::HomeGrid(const std::vector<vec3>& _homes, Box bound, float _cellSize) : homes(_homes), box(bound), cellSize(_cellSize) {
+    dims = ivec3(max(ceil(box.size / cellSize), vec3(1)));
+    cells.resize(dims.x * dims.y * dims.z);
+    for (int z = 0; z < dims.z; ++z) {
+        for (int y = 0; y < dims.y; ++y) {
+            for (int x = 0; x < dims.x; ++x) {
+                vec3 centre = box.low + (vec3(x, y, z) + 0.5f) * cellSize;
+                int nearest = -1;
+                float nearestDist = 1e18;  // squared
+                for (int h = 0; h < homes.size(); ++h) {
+                    float d = Util::sqDist(centre, homes[h]);
+                    if (d < nearestDist) nearest = h, nearestDist = d;
+                }
+                cells[flatten(ivec3(x, y, z))] = {nearest, nearest == -1 ? 1e9f : sqrtf(nearestDist)};
+            }
+        }
+    }
+}
+
+// get the (clamped) cell containing `p`
+ivec3 HomeGrid::getCellCoords(vec3 p) const {
+    // clamp before converting so far away (or nan) positions can't overflow
+    vec3 c = floor((p - box.low) / cellSize);
+    return ivec3(clamp(c, vec3(0), vec3(dims - 1)));
+}
+
+// Get the index of the home nearest to `p`, or -1 if it isn't within `range`
+int HomeGrid::getNearestHome(vec3 p, float range) const {
+    const HomeCell& cell = getCell(p);
+    // `p` is at most half a cell diagonal from the cell centre, so the cell's distance rules most homes out without reading them
+    if (cell.home == -1 || cell.dist - cellSize * 0.8660254f > range) return -1;
+    if (Util::sqDist(p, homes[cell.home]) > range * range) return -1;
+    return cell.home;
+}
@@ -0,0 +1,41 @@
+#ifndef HOMEGRID_H
+#define HOMEGRID_H
+
+#include <vector>
+
+#include "box.h"
+#include "sm.h"
+#include "util.h"
+
+#define HOME_GRID_CELL_SIZE 8  // width of a home grid cell
+
+// Nearest home to the centre of a home grid cell. Matches `HomeCell` in boids.comp
+struct HomeCell {
+    int home;    // index of the nearest home, or -1 if there are no homes
+    float dist;  // distance from the cell centre to that home
+};
+
+// Uniform grid over a fixed region, holding the nearest home to each cell. Homes never move, so it's baked once and
+// finding a boid's home is a single lookup however many homes there are.
+// The nearest home to a cell's centre can be a little further from a boid than some other home, but never by more than a cell.
+// Positions outside the region use the border cells.
+class HomeGrid {
+   public:
+    HomeGrid() {}
+    HomeGrid(const std::vector<vec3>& _homes, Box bound, float _cellSize = HOME_GRID_CELL_SIZE);
+
+    int getNearestHome(vec3 p, float range) const;
+    const HomeCell& getCell(vec3 p) const { return cells[flatten(getCellCoords(p))]; }
+
+    std::vector<vec3> homes;
+    std::vector<HomeCell> cells;  // indexed by `flatten`
+    Box box;
+    float cellSize = 1;
+    ivec3 dims = ivec3(1);  // number of cells along each axis
+
+   private:
+    ivec3 getCellCoords(vec3 p) const;
+    unsigned flatten(ivec3 c) const { return c.x + dims.x * (c.y + dims.y * c.z); }
+};
+
+#endif /* HOMEGRID_H */
@@ -0,0 +1,77 @@
+#include "instancering.h"
+
+#include <cstring>
+
+InstanceRing::InstanceRing(size_t _frameSize) : frameSize(_frameSize) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, frameSize * INSTANCE_RING_FRAMES, nullptr, flags);
+    mapped = (char*)glMapNamedBufferRange(buffer, 0, frameSize * INSTANCE_RING_FRAMES, flags);
+    if (!mapped) printf("Failed to map the instance ring buffer\n");
+}
+
+InstanceRing::~InstanceRing() {
+    for (auto f : fences) {
+        if (f) glDeleteSync(f);
+    }
+    glUnmapNamedBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+// Start writing the next frame's region, waiting for the GPU to finish the frame that last used it
+void InstanceRing::beginFrame() {
+    GLsync& fence = fences[frame];
+    if (fence) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    cursor = 0;
+}
+
+// Fence everything drawn from the current region, and move on to the next
+void InstanceRing::endFrame() {
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % INSTANCE_RING_FRAMES;
+}
+
+// Reserve `bytes` in the current frame's region. Returns where to write them, and sets `offset` to where they are in `buffer`.
+// If the region is full, waits for the GPU to finish with everything and starts the region again, which is correct but slow.
+// Requests bigger than a whole region can never fit, so they return nullptr and an offset of -1
+void* InstanceRing::allocate(size_t bytes, GLintptr& offset) {
+    if (bytes > frameSize) {
+        printf("Instance data of %zu bytes doesn't fit in the instance ring (%zu bytes a frame)\n", bytes, frameSize);
+        offset = -1;
+        return nullptr;
+    }
+    size_t start = (cursor + INSTANCE_RING_ALIGNMENT - 1) & ~(size_t)(INSTANCE_RING_ALIGNMENT - 1);
+    if (start + bytes > frameSize) {
+        if (!warnedFull) printf("Instance ring is full (%zu bytes a frame), stalling\n", frameSize);
+        warnedFull = true;
+        glFinish();
+        start = 0;
+    }
+    cursor = start + bytes;
+    offset = frame * frameSize + start;
+    return mapped + offset;
+}
+
+// Copy `bytes` of `data` into the current frame's region, or zeros if `data` is nullptr. Returns where they are in `buffer`,
+// or -1 if they don't fit
+GLintptr InstanceRing::upload(const void* data, size_t bytes) {
+    GLintptr offset;
+    void* dst = allocate(bytes, offset);
+    if (!dst) return -1;
+    if (data) memcpy(dst, data, bytes);
+    else memset(dst, 0, bytes);
+    return offset;
+}
+
+// Source the instanced attribute at `location` from `offset` in the ring. Matrices take `columns` consecutive locations, one
+// vec4 each. glVertexAttribPointer gives every attribute a binding of the same index, so each location is rebound on its own
+void InstanceRing::bindAttribute(unsigned int location, unsigned int columns, GLintptr offset, GLsizei stride) {
+    for (unsigned int i = 0; i < columns; ++i) {
+        glBindVertexBuffer(location + i, buffer, offset + i * sizeof(vec4), stride);
+    }
+}
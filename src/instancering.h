@@ -0,0 +1,39 @@
+#ifndef INSTANCERING_H
+#define INSTANCERING_H
+
+#include <GL/glew.h>
+
+#include "util.h"
+#include "sm.h"
+
+#define INSTANCE_RING_FRAMES 3                                                            // frames that can be in flight at once
+#define INSTANCE_RING_FRAME_SIZE (2 * SM::MAX_NUM_BOIDS * (sizeof(mat4) + sizeof(float)))  // bytes each frame can write
+#define INSTANCE_RING_ALIGNMENT 16                                                         // alignment of every allocation
+
+// Persistently mapped, fenced ring buffer for per-frame instance data (transforms, atlas depths).
+// The buffer is split into one region per frame in flight. Meshes write straight into the current frame's region, then point
+// their instanced attributes at what they wrote, so there is no copy through the driver and no implicit sync on a buffer the
+// GPU may still be reading. A frame's region is only reused once the fence placed after it has passed.
+class InstanceRing {
+   public:
+    InstanceRing(size_t _frameSize = INSTANCE_RING_FRAME_SIZE);
+    ~InstanceRing();
+
+    void beginFrame();
+    void endFrame();
+    void* allocate(size_t bytes, GLintptr& offset);
+    GLintptr upload(const void* data, size_t bytes);
+    void bindAttribute(unsigned int location, unsigned int columns, GLintptr offset, GLsizei stride);
+
+    unsigned int buffer = 0;
+
+   private:
+    char* mapped = nullptr;  // start of the whole buffer
+    size_t frameSize = 0;
+    size_t cursor = 0;  // bytes used in the current frame's region
+    int frame = 0;      // region being written
+    GLsync fences[INSTANCE_RING_FRAMES] = {};
+    bool warnedFull = false;
+};
+
+#endif /* INSTANCERING_H */
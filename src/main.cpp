@@ -10,6 +10,10 @@ void init() {
     glDebugMessageCallback(MessageCallback, 0);
     srand(time(nullptr));
 
+    // every mesh points its instanced attributes at the ring, so it must exist before any are loaded
+    SM::instanceRing = new InstanceRing();
+    SM::profiler = new Profiler();
+
     /// -------------------------------------------------- SHADERS -------------------------------------------------- ///
     Shader* s = new Shader("static", vert_smesh, frag_smesh);
     shaders[s->name] = s;
@@ -99,6 +103,22 @@ void init() {
         });
     flock = new Flock(flockVariants, anemonePos);
 
+    // every static mesh instance, for the flock to steer around. boids are drawn at twice their simulated position (see
+    // Util::lookTowards), so the geometry is halved into the space the flock is simulated in
+    std::vector<vec3> obstacleTris;
+    int instance = 0;
+    for (auto v : staticVariants->variants) {
+        for (int i = 0; i < v->instanceCount; ++i, ++instance) {
+            for (const auto &m : v->mesh->meshes) {
+                for (unsigned j = 0; j < m.n_Indices; ++j) {
+                    vec3 p = v->mesh->vertices[m.baseVertex + v->mesh->indices[m.baseIndex + j]];
+                    obstacleTris.push_back(vec3(stvMats[instance] * vec4(p, 1)) / 2.f);
+                }
+            }
+        }
+    }
+    flock->setObstacles(DistanceField::loadOrBake(PROJDIR "sdf.cache", obstacleTris, Box(SM::sceneBox->low / 2.f, SM::sceneBox->high / 2.f)));
+
     /// -------------------------------------------------- LIGHTS -------------------------------------------------- ///
     float beaconAttLin = 0.00000009;
     float beaconAttQuad = 0.000000009;
@@ -171,6 +191,8 @@ void init() {
 }
 
 void display() {
+    SM::profiler->beginFrame();
+    SM::instanceRing->beginFrame();  // wait until the gpu is done with the instance data written three frames ago
     // tell GL to only draw onto a pixel if the shape is closer to the viewer
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);  // enable depth-testing
@@ -192,6 +214,7 @@ void display() {
     staticLight->use();
 
     if (showGround) {
+        ProfileScope scope("Static Meshes");
         staticVariants->render(stvMats.data());
     }
 
@@ -201,6 +224,7 @@ void display() {
     boneLight->shader->setBool("showNormal", SM::showNormal);
     boneLight->use();
 
+    SM::profiler->begin("Player");
     if (SM::isFirstPerson) {
         player->lookAt(SM::camera->front);
         SM::camera->followTarget(vec3(player->transform[3]), Util::FORWARD);
@@ -212,8 +236,10 @@ void display() {
         player->render();
         player->lookAt(player->dir);
     }
+    SM::profiler->end();
 
     if (showGround) {
+        ProfileScope scope("Kelp");
         bmeshes["kelp"]->update(100);
         bmeshes["kelp"]->render(skvMats.size(), skvMats.data());
     }
@@ -232,12 +258,15 @@ void display() {
     variantLight->setLightAtt(view, persp_proj, SM::camera->pos);
     variantLight->setSpotLightAtt(0, flashlightCoords, flashlightDir, vec3(0.2f), vec3(1, .6, .2), vec3(1));
     variantLight->use();
-    flock->process(player->pos, SM::updateDistance);
-    if (showBoids) flock->show();
+    SM::profiler->begin("Flock Step");
+    for (int i = SM::takeSimSteps(); i > 0; --i) flock->process(player->pos, SM::updateDistance);
+    SM::profiler->end();
+    if (showBoids) flock->show(SM::simAlpha);
 
     /// ------------------------------------------------ DEBUG MENU ------------------------------------------------ ///
     // Handle ImGui window
     if (SM::debug) {
+        ProfileScope scope("ImGui");
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGLUT_NewFrame();
         ImGui::NewFrame();
@@ -254,6 +283,46 @@ void display() {
         }
         ImGui::Checkbox("Change background colour from height", &useHeightBackground);
         ImGui::Checkbox("Enable Attacking", &SM::canBoidsAttack);
+        ImGui::Checkbox("Use Spatial Grid", &flock->useGrid);
+        ImGui::Checkbox("Spatial Reordering", &flock->reorderBoids);
+        if (flock->obstacles) {
+            ImGui::Checkbox("Avoid Obstacles", &flock->useObstacles);
+            if (flock->useObstacles) {
+                ImGui::SliderFloat("Obstacle Range", &flock->obstacles->avoidRange, 0.f, flock->obstacles->band);
+                ImGui::SliderFloat("Obstacle Weight", &flock->obstacles->avoidWeight, 0.f, 10.f);
+            }
+        }
+        ImGui::Checkbox("Use Neighbour Lists", &flock->useNeighbourLists);
+        ImGui::SameLine();
+        ImGui::SliderFloat("Skin", &flock->neighbourSkin, 0.5f, 8.f);
+#ifdef TREE
+        if (BoidKernel::hasAVX2()) ImGui::Checkbox("Use SIMD Kernel", &BoidKernel::useSIMD);
+        if (flock->useGrid) ImGui::Checkbox("Split Type Queries", &flock->splitTypeQueries);
+        if (!flock->useGrid) {
+            ImGui::Checkbox("Topological Neighbours", &flock->topologicalNeighbours);
+            ImGui::SameLine();
+            ImGui::SliderInt("##Topological", &flock->numTopological, 1, MAX_NEAREST);
+        }
+#else
+        if (!flock->useGrid) ImGui::Checkbox("Tiled Brute Force", &flock->useTiles);
+        ImGui::Checkbox("Frustum Culling", &flock->useCulling);
+        ImGui::Checkbox("Mesh LOD", &flock->useMeshLOD);
+        if (flock->useMeshLOD) ImGui::SliderFloat2("LOD Screen Sizes", &flockVariants->lodSizes.x, 0.f, .2f);
+        ImGui::Checkbox("Distance LOD", &flock->useLOD);
+        if (flock->useLOD) ImGui::SliderFloat3("LOD Ranges", &flock->lodRanges.x, 1.f, 8.f);
+        if (ImGui::TreeNode("Boid Types")) {
+            bool changed = false;
+            for (int t = 0; t < NUM_BOID_TYPES; ++t) {
+                BoidTypeS& bt = flock->type_structs[t];
+                std::string name = BoidInfo::getBoidName((BoidType)t);
+                ImGui::Text("%s", name.c_str());
+                changed |= ImGui::SliderFloat(("Max Speed##" + name).c_str(), &bt.max_speed, bt.min_speed, 20.f);
+                changed |= ImGui::SliderFloat(("Goal Weight##" + name).c_str(), &bt.goalWeight, 0.f, 1.f);
+            }
+            if (changed) flock->updateTypeParams();
+            ImGui::TreePop();
+        }
+#endif
         ImGui::SliderFloat("Speed Factor", &flock->speedFactor, 0.1f, 10.f);
         ImGui::SameLine();
         if (ImGui::Button("Reset##Speed")) {
@@ -269,6 +338,7 @@ void display() {
         }
         SM::fogBounds.y = SM::updateDistance; // update fog bounds too
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+        SM::profiler->drawMenu();
         if (ImGui::Button("Centre Player")) {
             player->pos = vec3(0);
         }
@@ -283,6 +353,8 @@ void display() {
     }
 
     glutSwapBuffers();
+    SM::instanceRing->endFrame();
+    SM::profiler->endFrame();
 }
 
 void updateScene() {
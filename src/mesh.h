@@ -22,6 +22,8 @@
 #include "sm.h"
 #include "texture.h"
 #include "shader.h"
+#include "instancering.h"
+#include "profiler.h"
 
 #define MAX_NUM_BONES_PER_VERTEX 4
 #define MAX_JOINTS_PER_BONE 16  // maximum number of children a bone can have
@@ -224,7 +226,6 @@ class Mesh {
     unsigned int t_VBO = 0;                              // texture vbo
     unsigned int d_VBO = 0;                              // texture depth vbo
     unsigned int EBO = 0;                                // index (element) vbo (ebo)
-    unsigned int IBO = 0;                                // instance vbo (ibo)
     unsigned int BBO = 0;                                // bone ids and weights vbo
     unsigned int ABBO;                                   // animated bone transform ssbo
     unsigned int BIBO;                                   // bone info ssbo
@@ -1,61 +1,141 @@
 #include "octree.h"
 
-void Octree::insert(Boid* boid) {
-    // if the box is at or below the minimum size, add it (last resort)
-    auto bsize = box.size;
-    if (bsize.x <= MIN_BOX_SIZE && bsize.y <= MIN_BOX_SIZE && bsize.z <= MIN_BOX_SIZE) {
-        indices[bcount++] = boid->ID;
-        return;
-    }
+#include <algorithm>
 
-    // if the box can fit it, add it
-    if (bcount < MAX_CHILD_COUNT) {
-        indices[bcount++] = boid->ID;
-        return;
+void Octree::insert(unsigned id) {
+    if (boidNode.size() < bc->size) {
+        boidNode.resize(bc->size, -1);
+        boidSlot.resize(bc->size, 0);
     }
+    vec3 pos = bc->pos[id];
+    int node = 0;
+    while (true) {
+        OctreeNode& n = nodes[node];
 
-    int octant = box.getOctant(boid->pos);
-    auto nBoxs = box.split();
-    Box nBox = nBoxs[octant];
+        // if the box is at or below the minimum size, add it (last resort)
+        auto bsize = n.box.size;
+        // if the box can fit it, add it
+        if ((bsize.x <= MIN_BOX_SIZE && bsize.y <= MIN_BOX_SIZE && bsize.z <= MIN_BOX_SIZE) || n.indices.size() < MAX_CHILD_COUNT) {
+            boidNode[id] = node;
+            boidSlot[id] = n.indices.size();
+            n.indices.push_back(id);
+            return;
+        }
 
-    if (!children[octant]) {
-        children[octant] = new Octree(nBox);
-        children[octant]->bc = bc;
+        int octant = n.box.getOctant(pos);
+        if (n.children[octant] == -1) {
+            Box child = n.box.getChild(octant);
+            n.children[octant] = nodes.size();
+            nodes.emplace_back(child);  // invalidates `n`
+        }
+        node = nodes[node].children[octant];
     }
-    children[octant]->insert(boid);
 }
 
-// Get a list of boid indices within the radius `range` around `origin`. The size of the list will be held in `count`.
-const unsigned* Octree::getBoidsInRange(vec3 origin, float range, int& count) {
-    unsigned* idxs = new unsigned[MAX_CHECK];
-    int cnt = 0;
-    getBoidsInRange(origin, range, cnt, idxs);
-    count = cnt;
-    return idxs;
+// Write the indices of boids within the radius `range` around `origin` into `out`, and return how many were written.
+// At most `out.size()` boids are returned. The octant containing `origin` is searched first, so if the list fills up
+// the boids closest to `origin` are more likely to be in it.
+int Octree::getBoidsInRange(vec3 origin, float range, std::span<unsigned> out) {
+    int count = 0;
+    getBoidsInRange(0, origin, range * range, out, count);
+    return count;
 }
 
 // helper function
-unsigned* Octree::getBoidsInRange(vec3 origin, float range, int& count, unsigned* acc) {
-    float dist = range * range;
-    int octant = box.getOctant(origin);
-    if (children[octant]) acc = children[octant]->getBoidsInRange(origin, range, count, acc);
-
-    for (int i = 0; i < bcount && count < MAX_CHECK; ++i) {
-        auto idx = indices[i];
-        if (idx != -1 && Util::sqDist(bc->boids[idx]->pos, origin) <= dist) {
-            acc[count++] = idx;
+void Octree::getBoidsInRange(int node, vec3 origin, float radSqr, std::span<unsigned> out, int& count) {
+    for (unsigned i = 0; i < nodes[node].indices.size() && count < out.size(); ++i) {
+        auto idx = nodes[node].indices[i];
+        if (Util::sqDist(bc->pos[idx], origin) <= radSqr) {
+            out[count++] = idx;
         }
     }
-    return acc;
+
+    // visit every child touching the search sphere, starting with the one containing the origin
+    int first = nodes[node].box.getOctant(origin);
+    for (int i = 0; i < OCT && count < out.size(); ++i) {
+        int c = nodes[node].children[first ^ i];
+        if (c != -1 && nodes[c].box.inRange(origin, radSqr)) getBoidsInRange(c, origin, radSqr, out, count);
+    }
 }
 
-void Octree::reset() {
-    bcount = 0;
-    for (int i = 0; i < OCT; ++i) {
-        if (children[i]) {
-            children[i]->reset();
-            // delete children[i];
-            // children[i] = nullptr;
+// Write the indices of the (at most) `k` boids closest to `origin` and within `range` into `out`, nearest first,
+// and return how many were written. Boid `exclude` is skipped, so a boid can find its own neighbours.
+// `k` is clamped to MAX_NEAREST and the size of `out`.
+int Octree::getNearest(vec3 origin, int k, float range, unsigned exclude, std::span<unsigned> out) {
+    Candidate heap[MAX_NEAREST];
+    int count = 0;
+    float radSqr = range * range;
+    k = std::min({k, MAX_NEAREST, (int)out.size()});
+    if (k <= 0) return 0;
+    getNearest(0, origin, k, radSqr, exclude, heap, count);
+
+    std::sort_heap(heap, heap + count);
+    for (int i = 0; i < count; ++i) out[i] = heap[i].idx;
+    return count;
+}
+
+// helper function. `heap` is a max-heap of the `count` closest boids so far. once it holds `k` boids, `radSqr` shrinks
+// to the furthest of them, so only nodes that could hold something closer are visited
+void Octree::getNearest(int node, vec3 origin, int k, float& radSqr, unsigned exclude, Candidate* heap, int& count) {
+    for (auto idx : nodes[node].indices) {
+        if (idx == exclude) continue;
+        float d = Util::sqDist(bc->pos[idx], origin);
+        if (d > radSqr) continue;
+        if (count == k) {
+            std::pop_heap(heap, heap + count--);
         }
+        heap[count++] = {d, idx};
+        std::push_heap(heap, heap + count);
+        if (count == k) radSqr = heap[0].dist;
+    }
+
+    int first = nodes[node].box.getOctant(origin);
+    for (int i = 0; i < OCT; ++i) {
+        int c = nodes[node].children[first ^ i];
+        if (c != -1 && nodes[c].box.sqDistTo(origin) <= radSqr) getNearest(c, origin, k, radSqr, exclude, heap, count);
+    }
+}
+
+// Take a boid out of the tree. The last boid in its node takes its slot
+void Octree::remove(unsigned id) {
+    int node = boidNode[id];
+    if (node == -1) return;
+    auto& idxs = nodes[node].indices;
+    unsigned slot = boidSlot[id];
+    unsigned last = idxs.back();
+    idxs[slot] = last;
+    boidSlot[last] = slot;
+    idxs.pop_back();
+    boidNode[id] = -1;
+}
+
+// Empty every node, keeping the nodes and their storage for the next frame
+void Octree::reset() {
+    for (auto& n : nodes) n.indices.clear();
+    std::fill(boidNode.begin(), boidNode.end(), -1);
+}
+
+// Rebuild the tree from scratch
+void Octree::build() {
+    reset();
+    for (unsigned i = 0; i < bc->size; ++i) insert(i);
+}
+
+// Reinsert every boid that has moved out of its node's box, and return how many moved.
+// The root takes anything, so boids in it never move. Removals leave nodes less full than they could be, which doesn't
+// affect queries but makes them slower over time, so `build` should still be called every so often.
+unsigned Octree::update() {
+    if (boidNode.size() < bc->size) {
+        build();
+        return bc->size;
+    }
+    unsigned moved = 0;
+    for (unsigned i = 0; i < bc->size; ++i) {
+        int node = boidNode[i];
+        if (node == 0 || (node != -1 && nodes[node].box.contains(bc->pos[i]))) continue;
+        remove(i);
+        insert(i);
+        moved++;
     }
+    return moved;
 }
@@ -5,42 +5,61 @@
 #define MIN_BOX_SIZE 1
 #define MAX_CHILD_COUNT 64
 #define MAX_CHECK 1024
+#define MAX_NEAREST 32  // largest k for Octree::getNearest
+
+#include <span>
 
 #include "boid.h"
 #include "box.h"
 #include "sm.h"
 #include "util.h"
 
+// A single node of the octree. Children are indices into the octree's node pool, or -1 if not created yet.
+struct OctreeNode {
+    OctreeNode(Box bound) : box(bound) {
+        for (int i = 0; i < OCT; ++i) children[i] = -1;
+    }
+
+    Box box;
+    int children[OCT];
+    std::vector<unsigned> indices;  // list of boid indices. only grows as large as the node's occupancy
+};
+
+// Octree over the boids in a BoidContainer.
+// Nodes live in a single pool and are never freed, and `reset` only empties them, so after the first few frames
+// rebuilding the tree and querying it doesn't allocate.
+// The node and slot of every boid is tracked, so `update` can move only the boids that left their node instead of
+// rebuilding the whole tree.
 class Octree {
    public:
     Octree() {}
-    Octree(Box bound) {
-        box = bound;
-        for (int i = 0; i < OCT; ++i) children[i] = nullptr;
-    }
-
     Octree(BoidContainer*& cnt, Box bound) : bc(cnt) {
-        box = bound;
-        for (int i = 0; i < OCT; ++i) children[i] = nullptr;
-    }
-
-    ~Octree() {
-        for (int i = 0; i < OCT; ++i) {
-            delete children[i];
-            children[i] = nullptr;
-        }
+        nodes.emplace_back(bound);
     }
 
-    const unsigned* getBoidsInRange(vec3 origin, float range, int& count);
-    unsigned* getBoidsInRange(vec3 origin, float range, int& count, unsigned* acc);
-    void insert(Boid*);
+    int getBoidsInRange(vec3 origin, float range, std::span<unsigned> out);
+    int getNearest(vec3 origin, int k, float range, unsigned exclude, std::span<unsigned> out);
+    void insert(unsigned id);
+    void remove(unsigned id);
     void reset();
+    void build();
+    unsigned update();
 
-    Octree* children[OCT];
     BoidContainer* bc;
-    unsigned indices[MAX_CHILD_COUNT * MAX_CHILD_COUNT];  // list of boid indices
-    unsigned bcount = 0;                                  // number of boids in the list. always points to the top of the `indices` list.
-    Box box;
+    std::vector<OctreeNode> nodes;  // node pool. the root is always nodes[0]
+    std::vector<int> boidNode;      // node holding each boid, or -1 if not in the tree
+    std::vector<unsigned> boidSlot; // position of each boid in its node's index list
+
+   private:
+    // candidate for the nearest neighbour heap, ordered by distance so the heap top is the furthest
+    struct Candidate {
+        float dist;
+        unsigned idx;
+        bool operator<(const Candidate& o) const { return dist < o.dist; }
+    };
+
+    void getBoidsInRange(int node, vec3 origin, float radSqr, std::span<unsigned> out, int& count);
+    void getNearest(int node, vec3 origin, int k, float& radSqr, unsigned exclude, Candidate* heap, int& count);
 };
 
 #endif /* OCTREE_H */
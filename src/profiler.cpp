@@ -0,0 +1,201 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "imgui/imgui.h"
+
+static float msSince(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// Average of the `count` filled entries of a history. histories fill from the start, so they're always the first ones
+static float historyAverage(const float* history, int count) {
+    if (count == 0) return 0;
+    float sum = 0;
+    for (int i = 0; i < count; ++i) sum += history[i];
+    return sum / count;
+}
+
+Profiler::Profiler() {
+    frameStart = std::chrono::steady_clock::now();
+}
+
+Profiler::~Profiler() {
+    stopCapture();
+    for (auto& p : passes) glDeleteQueries(PROFILER_QUERY_SETS, p.queries);
+}
+
+// Read back the timings of the frame that last used `set`, now that it's about to be reused
+void Profiler::collect(int set) {
+    bool record = frameIssued[set];
+    unsigned frameNumber = frame - PROFILER_QUERY_SETS;
+    int last = (historyHead + PROFILER_HISTORY - 1) % PROFILER_HISTORY;
+    float gpuTotal = 0;
+    for (auto& p : passes) {
+        float gpu = 0, cpu = 0;
+        bool dropped = false;
+        if (p.issued[set]) {
+            GLint available = 0;
+            glGetQueryObjectiv(p.queries[set], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(p.queries[set], GL_QUERY_RESULT, &ns);
+                gpu = ns / 1e6f;
+            } else {
+                dropped = true;  // the gpu is more than two frames behind. waiting for it would defeat the point
+                gpu = p.gpuHistory[last];
+            }
+            cpu = p.cpuMs[set];
+            if (record && capture) {
+                fprintf(capture, "%u,%s,%.4f,", frameNumber, p.name.c_str(), cpu);
+                if (dropped) fprintf(capture, "\n");
+                else fprintf(capture, "%.4f\n", gpu);
+            }
+            p.issued[set] = false;
+        }
+        if (!record) continue;
+        p.gpuHistory[historyHead] = gpu;
+        p.cpuHistory[historyHead] = cpu;
+        gpuTotal += gpu;
+    }
+    if (!record) return;
+
+    frameCpuHistory[historyHead] = frameCpuMs[set];
+    frameGpuHistory[historyHead] = gpuTotal;
+    if (capture) {
+        fprintf(capture, "%u,Frame,%.4f,%.4f\n", frameNumber, frameCpuMs[set], gpuTotal);
+        capturedFrames++;
+    }
+    historyHead = (historyHead + 1) % PROFILER_HISTORY;
+    historyCount = std::min(historyCount + 1, PROFILER_HISTORY);
+    frameIssued[set] = false;
+}
+
+// Call at the very start of the frame
+void Profiler::beginFrame() {
+    collect(frame % PROFILER_QUERY_SETS);
+    frameStart = std::chrono::steady_clock::now();
+}
+
+// Call at the very end of the frame, after the buffers are swapped
+void Profiler::endFrame() {
+    end();
+    int set = frame % PROFILER_QUERY_SETS;
+    frameCpuMs[set] = msSince(frameStart);
+    frameIssued[set] = enabled;
+    frame++;
+}
+
+int Profiler::findPass(const char* name) {
+    for (int i = 0; i < passes.size(); ++i) {
+        if (passes[i].name == name) return i;
+    }
+    ProfilerPass p;
+    p.name = name;
+    glCreateQueries(GL_TIME_ELAPSED, PROFILER_QUERY_SETS, p.queries);
+    passes.push_back(p);
+    return passes.size() - 1;
+}
+
+// Start timing the pass `name`, ending the pass that's open. A pass timed more than once a frame adds up its cpu time, but
+// only its first gpu time is kept, as its query can't be reused until it's read back
+void Profiler::begin(const char* name) {
+    end();
+    if (!enabled) return;
+    int set = frame % PROFILER_QUERY_SETS;
+    current = findPass(name);
+    ProfilerPass& p = passes[current];
+    queryActive = !p.issued[set];
+    if (queryActive) {
+        glBeginQuery(GL_TIME_ELAPSED, p.queries[set]);
+        p.issued[set] = true;
+        p.cpuMs[set] = 0;
+    }
+    passStart = std::chrono::steady_clock::now();
+}
+
+// Stop timing the open pass, if there is one
+void Profiler::end() {
+    if (current < 0) return;
+    if (queryActive) glEndQuery(GL_TIME_ELAPSED);
+    passes[current].cpuMs[frame % PROFILER_QUERY_SETS] += msSince(passStart);
+    current = -1;
+    queryActive = false;
+}
+
+// Start writing every frame's timings to a csv file at `path`, one row per pass and a "Frame" row with the totals.
+// gpu times that were dropped are left empty
+bool Profiler::startCapture(const std::string& path) {
+    stopCapture();
+    capture = fopen(path.c_str(), "w");
+    if (!capture) {
+        printf("Failed to open profiler capture \"%s\"\n", path.c_str());
+        return false;
+    }
+    fprintf(capture, "frame,pass,cpu_ms,gpu_ms\n");
+    capturedFrames = 0;
+    return true;
+}
+
+void Profiler::stopCapture() {
+    if (!capture) return;
+    fclose(capture);
+    capture = nullptr;
+    printf("Captured %u frames of profiler timings\n", capturedFrames);
+}
+
+// Draw the pass breakdown and graph into the current ImGui window
+void Profiler::drawMenu() {
+    if (!ImGui::TreeNode("Profiler")) return;
+    ImGui::Checkbox("Enabled", &enabled);
+    ImGui::SameLine();
+    if (capture) {
+        if (ImGui::Button("Stop Capture")) stopCapture();
+        ImGui::SameLine();
+        ImGui::Text("%u frames", capturedFrames);
+    } else if (ImGui::Button("Capture CSV")) {
+        startCapture(capturePath);
+    }
+
+    // averages over the history. select a pass to graph it
+    float frameGpu = historyAverage(frameGpuHistory, historyCount);
+    float frameCpu = historyAverage(frameCpuHistory, historyCount);
+    if (ImGui::BeginTable("Passes", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("Pass");
+        ImGui::TableSetupColumn("GPU ms");
+        ImGui::TableSetupColumn("CPU ms");
+        ImGui::TableSetupColumn("GPU %");
+        ImGui::TableHeadersRow();
+        for (int i = -1; i < (int)passes.size(); ++i) {
+            const char* name = i < 0 ? "Frame" : passes[i].name.c_str();
+            float gpu = i < 0 ? frameGpu : historyAverage(passes[i].gpuHistory, historyCount);
+            float cpu = i < 0 ? frameCpu : historyAverage(passes[i].cpuHistory, historyCount);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (ImGui::Selectable(name, graphPass == i, ImGuiSelectableFlags_SpanAllColumns)) graphPass = i;
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", gpu);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", cpu);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", frameGpu > 0 ? gpu / frameGpu * 100 : 0.f);
+        }
+        ImGui::EndTable();
+    }
+
+    // the oldest entry is the one about to be overwritten
+    const float* gpu = graphPass < 0 ? frameGpuHistory : passes[graphPass].gpuHistory;
+    const float* cpu = graphPass < 0 ? frameCpuHistory : passes[graphPass].cpuHistory;
+    ImGui::PlotLines("GPU ms", gpu, PROFILER_HISTORY, historyHead, nullptr, 0, FLT_MAX, ImVec2(0, 60));
+    ImGui::PlotLines("CPU ms", cpu, PROFILER_HISTORY, historyHead, nullptr, 0, FLT_MAX, ImVec2(0, 60));
+    ImGui::TreePop();
+}
+
+ProfileScope::ProfileScope(const char* name) {
+    if (SM::profiler) SM::profiler->begin(name);
+}
+
+ProfileScope::~ProfileScope() {
+    if (SM::profiler) SM::profiler->end();
+}
@@ -0,0 +1,74 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "util.h"
+#include "sm.h"
+
+#define PROFILER_QUERY_SETS 2  // frames of queries in flight. a set is read back when it is next reused, two frames later
+#define PROFILER_HISTORY 240   // frames of timings kept for the averages and graph
+
+// One named pass of the frame, and its recent timings
+struct ProfilerPass {
+    std::string name;
+    unsigned int queries[PROFILER_QUERY_SETS] = {};  // GL_TIME_ELAPSED queries, one per set
+    bool issued[PROFILER_QUERY_SETS] = {};           // whether the frame that last used a set timed this pass
+    float cpuMs[PROFILER_QUERY_SETS] = {};           // cpu time of that frame, held back until its gpu time is read
+    float gpuHistory[PROFILER_HISTORY] = {};
+    float cpuHistory[PROFILER_HISTORY] = {};
+};
+
+// Per-pass gpu and cpu frame timings. Passes are wrapped in `begin`/`end` (or a ProfileScope), each timed on the gpu with a
+// GL_TIME_ELAPSED query and on the cpu with a steady clock. Query results are only read back two frames later, once the
+// query set is reused, and are dropped rather than waited on if the gpu still hasn't got to them, so profiling never stalls.
+// Only one GL_TIME_ELAPSED query can be active at a time, so passes can't nest; beginning a pass ends the one that's open.
+class Profiler {
+   public:
+    Profiler();
+    ~Profiler();
+
+    void beginFrame();
+    void endFrame();
+    void begin(const char* name);
+    void end();
+
+    void drawMenu();
+    bool startCapture(const std::string& path);
+    void stopCapture();
+
+    bool enabled = true;
+    std::string capturePath = PROJDIR "profile.csv";  // where the debug menu's capture button writes to
+
+   private:
+    void collect(int set);
+    int findPass(const char* name);
+
+    std::vector<ProfilerPass> passes;
+    int current = -1;          // pass being timed, or -1
+    bool queryActive = false;  // whether `current` has a gpu query running
+    unsigned frame = 0;        // frames begun so far
+    int historyHead = 0;       // next slot to write in each history
+    int historyCount = 0;      // filled slots of each history
+    int graphPass = -1;        // pass shown in the graph, or -1 for the whole frame
+    std::chrono::steady_clock::time_point frameStart, passStart;
+    float frameCpuMs[PROFILER_QUERY_SETS] = {};
+    bool frameIssued[PROFILER_QUERY_SETS] = {};  // whether the set holds a frame that hasn't been collected yet
+    float frameCpuHistory[PROFILER_HISTORY] = {};
+    float frameGpuHistory[PROFILER_HISTORY] = {};
+    FILE* capture = nullptr;
+    unsigned capturedFrames = 0;
+};
+
+// Times the pass `name` until the end of the enclosing scope
+struct ProfileScope {
+    ProfileScope(const char* name);
+    ~ProfileScope();
+};
+
+#endif /* PROFILER_H */
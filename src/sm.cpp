@@ -1,5 +1,7 @@
 #include "sm.h"
+#ifndef HEADLESS
 #include "camera.h"  // fwd
+#endif
 #include "box.h"     // fwd
 
 namespace SM {
@@ -15,7 +17,12 @@ const float floor_position = 0.f;
 bool flashlightToggled = false;
 
 inline float delta = 0.0f;
+float simStep = 1.f / 60.f;
+int maxSimSteps = 4;
+float simAlpha = 0;
+#ifndef HEADLESS
 DWORD startTime = 0;
+#endif
 
 int unnamedMeshCount = 0;
 int unnamedBoneMeshCount = 0;
@@ -29,25 +36,43 @@ bool isFirstPerson = false;
 bool isThirdPerson = true;
 CAMERA_MODE camMode = CAMERA_MODE::THIRD;
 CAMERA_MODE lastCamMode = CAMERA_MODE::THIRD;
+#ifdef HEADLESS
+Camera *camera = nullptr;
+#else
 Camera *camera = new Camera(0.1f, 1000.0f, (float)SM::width / (float)SM::height);
+#endif
 
 Box *sceneBox = new Box(vec3(WORLD_BOUND_LOW * 2), vec3(WORLD_BOUND_HIGH * 2));
+InstanceRing *instanceRing = nullptr;
+Profiler *profiler = nullptr;
 
 bool showNormal = false;
 bool debug = false;
 bool canBoidsAttack = true;
 
 void updateDelta() {
-    static DWORD last_time = 0;
-    DWORD curr_time = timeGetTime();
-    if (last_time == 0) last_time = curr_time;
-    delta = (curr_time - last_time) * 0.001f;
+    static auto last_time = std::chrono::steady_clock::now();  // timeGetTime() is only accurate to the millisecond
+    auto curr_time = std::chrono::steady_clock::now();
+    delta = std::chrono::duration<float>(curr_time - last_time).count();
     last_time = curr_time;
 }
 
+// Advance the simulation clock by `delta` and get how many fixed steps the simulation should take this frame. If the
+// frame took so long that more than `maxSimSteps` are due, the rest are dropped instead of making the next frame slower too
+int takeSimSteps() {
+    static float accumulator = 0;
+    accumulator += delta;
+    int steps = (int)(accumulator / simStep);
+    accumulator -= steps * simStep;
+    simAlpha = accumulator / simStep;
+    return std::min(steps, maxSimSteps);
+}
+
+#ifndef HEADLESS
 float getGlobalTime() {
     return ((float)(timeGetTime() - SM::startTime)) * 0.001f;
 }
+#endif
 
 void updateMouse(int nx, int ny) {
     float xPos = width / 2.0;
@@ -1,16 +1,26 @@
 #ifndef SM_H
 #define SM_H
+#ifndef HEADLESS
 #include <windows.h>
+#endif
+#include <chrono>
 #include <iostream>
 #include "util.h"
 
 // #define TREE  // uncomment to enable cpu octree
 
+// headless builds (no window or GL context) can only simulate on the cpu
+#ifdef HEADLESS
+#define TREE
+#endif
+
 #define WORLD_BOUND_HIGH 112
 #define WORLD_BOUND_LOW -112
 
 class Camera;
 class Box;
+class InstanceRing;
+class Profiler;
 
 // Scene Manager singleton
 namespace SM {
@@ -22,8 +32,12 @@ enum CAMERA_MODE {
 
 // Update the global delta value on each frame.
 extern void updateDelta();
+// Advance the simulation clock by `delta`, and get how many `simStep` long steps to simulate this frame
+extern int takeSimSteps();
+#ifndef HEADLESS
 // How long the program has been running
 extern float getGlobalTime();
+#endif
 // Update the delta mouse positions
 extern void updateMouse(int nx, int ny);
 extern void switchFirstAndThirdCam();
@@ -34,8 +48,14 @@ extern void changeBoidAttackState();
 // delta time
 extern float delta;
 
+extern float simStep;    // length of a simulation step, in seconds
+extern int maxSimSteps;  // most simulation steps to catch up on in one frame. any time past that is dropped
+extern float simAlpha;   // how far the frame is from the last simulation state to the next, 0-1. for interpolating rendering
+
+#ifndef HEADLESS
 // start time of the program
 extern DWORD startTime;
+#endif
 
 extern const float floor_position;
 extern bool flashlightToggled;
@@ -64,6 +84,8 @@ extern CAMERA_MODE camMode;
 extern bool showNormal;
 
 extern Box *sceneBox;
+extern InstanceRing *instanceRing;  // per-frame instance data shared by every mesh. created once GL is up
+extern Profiler *profiler;          // gpu and cpu pass timings, shown in the debug menu
 extern bool debug;
 
 constexpr int MAX_NUM_BOIDS = 10000;  // maximum count of boids allowed to be rendered.
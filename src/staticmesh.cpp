@@ -176,9 +176,7 @@ void StaticMesh::populateBuffers() {
     glGenBuffers(1, &p_VBO);
     glGenBuffers(1, &n_VBO);
     glGenBuffers(1, &t_VBO);
-    glGenBuffers(1, &d_VBO);
     glGenBuffers(1, &EBO);
-    glGenBuffers(1, &IBO);
 
     glBindBuffer(GL_ARRAY_BUFFER, p_VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
@@ -198,16 +196,14 @@ void StaticMesh::populateBuffers() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, IBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(mat4) * SM::MAX_NUM_BOIDS, NULL, GL_DYNAMIC_DRAW);
+    // instance transforms and depths are written into the shared instance ring each draw, which rebinds them to where they went
+    glBindBuffer(GL_ARRAY_BUFFER, SM::instanceRing->buffer);
     for (unsigned int i = 0; i < 4; i++) {
         glEnableVertexAttribArray(ST_INSTANCE_LOC + i);
         glVertexAttribPointer(ST_INSTANCE_LOC + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (const void*)(i * sizeof(vec4)));
         glVertexAttribDivisor(ST_INSTANCE_LOC + i, 1);  // tell OpenGL this is an instanced vertex attribute.
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, d_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * SM::MAX_NUM_BOIDS, NULL, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(ST_DEPTH_LOC);
     glVertexAttribPointer(ST_DEPTH_LOC, 1, GL_FLOAT, GL_FALSE, sizeof(float), 0);
     glVertexAttribDivisor(ST_DEPTH_LOC, 1);  // tell OpenGL this is an instanced vertex attribute.
@@ -218,16 +214,18 @@ void StaticMesh::populateBuffers() {
 /// </summary>
 /// <param name="nInstances">The number of instances you would like to draw.</param>
 /// <param name="model_matrix">The matrices you would like to transform each instance with.</param>
+/// <param name="atlasDepths">The atlas depth of each instance, or nullptr to use the first tile for all of them.</param>
 void StaticMesh::render(unsigned int nInstances, const mat4* model_matrix, const float* atlasDepths) {
+    GLintptr matOffset = SM::instanceRing->upload(model_matrix, sizeof(mat4) * nInstances);
+    GLintptr depthOffset = SM::instanceRing->upload(atlasDepths, sizeof(float) * nInstances);
+    if (matOffset < 0 || depthOffset < 0) return;  // too many instances for the ring
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, IBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(mat4) * nInstances, &model_matrix[0]);
+    SM::instanceRing->bindAttribute(ST_INSTANCE_LOC, 4, matOffset, sizeof(mat4));
+    SM::instanceRing->bindAttribute(ST_DEPTH_LOC, 1, depthOffset, sizeof(float));
     for (unsigned int i = 0; i < meshes.size(); i++) {
         unsigned int mIndex = meshes[i].materialIndex;
         assert(mIndex < materials.size());
 
-        glBindBuffer(GL_ARRAY_BUFFER, d_VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * nInstances, &atlasDepths[0]);
         if (materials[mIndex].diffTex) materials[mIndex].diffTex->bind(GL_TEXTURE0);
         if (materials[mIndex].mtlsTex) materials[mIndex].mtlsTex->bind(GL_TEXTURE1);
 
@@ -254,8 +252,7 @@ void StaticMesh::render(unsigned int nInstances, const mat4* model_matrix, const
 /// <param name="nInstances">The number of instances you would like to draw.</param>
 /// <param name="model_matrix">The matrices you would like to transform each instance with.</param>
 void StaticMesh::render(unsigned int nInstances, const mat4* model_matrix) {
-    std::vector<float> dpths(nInstances, 0);
-    render(nInstances, model_matrix, dpths.data());
+    render(nInstances, model_matrix, nullptr);
 }
 
 /// <summary>
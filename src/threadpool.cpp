@@ -0,0 +1,79 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(unsigned _numThreads) {
+    numThreads = std::max(_numThreads, 1u);
+    slices = std::make_unique<Slice[]>(numThreads);
+    // the calling thread acts as thread 0
+    for (unsigned t = 1; t < numThreads; ++t) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCv.notify_all();
+    for (auto& w : workers) w.join();
+}
+
+// Call `fn(begin, end, thread)` over chunks of at most `grain` items covering [0, count), and wait for all of them to finish.
+// `thread` is in [0, size()) and can be used to index per-thread scratch data.
+void ThreadPool::parallelFor(unsigned count, unsigned grain, const Task& fn) {
+    if (count == 0) return;
+    grain = std::max(grain, 1u);
+    if (numThreads == 1 || count <= grain) {
+        fn(0, count, 0);
+        return;
+    }
+
+    for (unsigned t = 0; t < numThreads; ++t) {
+        slices[t].next.store((unsigned long long)count * t / numThreads, std::memory_order_relaxed);
+        slices[t].end = (unsigned long long)count * (t + 1) / numThreads;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &fn;
+        grainSize = grain;
+        running = numThreads - 1;
+        generation++;
+    }
+    startCv.notify_all();
+
+    run(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [this] { return running == 0; });
+    task = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned thread) {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCv.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        run(thread);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        doneCv.notify_one();
+    }
+}
+
+// Work through this thread's own slice, then steal from the others until every slice is empty
+void ThreadPool::run(unsigned thread) {
+    for (unsigned i = 0; i < numThreads; ++i) {
+        Slice& s = slices[(thread + i) % numThreads];
+        while (true) {
+            unsigned begin = s.next.fetch_add(grainSize, std::memory_order_relaxed);
+            if (begin >= s.end) break;
+            (*task)(begin, std::min(begin + grainSize, s.end), thread);
+        }
+    }
+}
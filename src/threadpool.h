@@ -0,0 +1,52 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for data-parallel loops.
+// `parallelFor` gives each thread a contiguous slice of the range, which it works through in small chunks.
+// Threads that finish their own slice early steal chunks from the other slices, so uneven work per item still balances.
+class ThreadPool {
+   public:
+    // range of work for a single thread in a parallel for. padded so threads don't share cache lines
+    struct alignas(64) Slice {
+        std::atomic<unsigned> next{0};
+        unsigned end = 0;
+    };
+
+    using Task = std::function<void(unsigned begin, unsigned end, unsigned thread)>;
+
+    ThreadPool(unsigned numThreads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    void parallelFor(unsigned count, unsigned grain, const Task& fn);
+
+    // number of threads taking part in a parallel for, including the calling thread
+    unsigned size() { return numThreads; }
+
+   private:
+    void workerLoop(unsigned thread);
+    void run(unsigned thread);
+
+    unsigned numThreads;
+    std::vector<std::thread> workers;
+    std::unique_ptr<Slice[]> slices;
+
+    std::mutex mutex;
+    std::condition_variable startCv;
+    std::condition_variable doneCv;
+    unsigned generation = 0;  // incremented for every parallel for, so workers know there's new work
+    unsigned running = 0;     // workers still running the current parallel for
+    bool stopping = false;
+
+    const Task* task = nullptr;
+    unsigned grainSize = 1;
+};
+
+#endif /* THREADPOOL_H */
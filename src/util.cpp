@@ -8,7 +8,11 @@ vec3 X = vec3(1.f, 0.f, 0.f);
 vec3 Y = vec3(0.f, 1.f, 0.f);
 vec3 Z = vec3(0.f, 0.f, 1.f);
 std::random_device rand_dev;
-std::mt19937 mt_gen(rand_dev());
+std::mutex rand_dev_mutex;
+thread_local std::mt19937 mt_gen([] {
+    std::lock_guard<std::mutex> lock(rand_dev_mutex);
+    return rand_dev();
+}());
 
 std::string readFile(const char* path) {
     std::ifstream file(path);
@@ -83,6 +87,32 @@ vec3 randomv(int lo, int hi) {
         d(mt_gen));
 }
 
+// Spread the lower 10 bits of `v` out so there are two 0 bits between each of them
+static unsigned expandBits(unsigned v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// Compute the 30-bit Morton code of `p` inside the box [`low`, `high`]. Points outside the box are clamped to it.
+// Points close together in space mostly have close codes. https://developer.nvidia.com/blog/thinking-parallel-part-iii-tree-construction-gpu/
+unsigned mortonCode(vec3 p, vec3 low, vec3 high) {
+    vec3 t = glm::clamp((p - low) / (high - low), vec3(0), vec3(1)) * 1023.f;
+    return (expandBits((unsigned)t.x) << 2) | (expandBits((unsigned)t.y) << 1) | expandBits((unsigned)t.z);
+}
+
+// Get the order that sorts `points` by Morton code. `order[i]` is the index of the point that should be at position `i`
+std::vector<unsigned> mortonOrder(const vec3* points, unsigned count, vec3 low, vec3 high) {
+    std::vector<std::pair<unsigned, unsigned>> keys(count);
+    for (unsigned i = 0; i < count; ++i) keys[i] = {mortonCode(points[i], low, high), i};
+    std::sort(keys.begin(), keys.end());
+    std::vector<unsigned> order(count);
+    for (unsigned i = 0; i < count; ++i) order[i] = keys[i].second;
+    return order;
+}
+
 // Map a value `v` from input range `[inLow, inHigh]` to output range `[outLow, outHigh]`
 // https://stackoverflow.com/a/5732390
 float mapRange(float v, float inLow, float inHigh, float outLow, float outHigh) {
@@ -143,6 +173,7 @@ vec3 getTranslation(mat4& mat) {
     return trans;
 }
 
+#ifndef HEADLESS
 aiMatrix4x4 GLMtoAI(const mat4& mat) {
     aiMatrix4x4 p = aiMatrix4x4();
     p.a1 = mat[0][0];
@@ -191,6 +222,7 @@ vec3 aiToGLM(aiVector3D* from) {
         from->y,
         from->z);
 }
+#endif
 
 // Create a matrix at position `from` looking in the direction `to`. Uses the global up direction (0, 1, 0)
 mat4 lookTowards(vec3 from, vec3 to) {
@@ -206,6 +238,17 @@ mat4 lookTowards(vec3 from, vec3 to, vec3 up) {
     return mat * inverse(lookAt(from, from + to, up));
 }
 
+// Extract the six planes of the frustum of `viewProj` (left, right, bottom, top, near, far), normalised and facing inwards.
+// A point `p` is inside plane `pl` if `dot(vec3(pl), p) + pl.w >= 0`. https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+void frustumPlanes(const mat4& viewProj, vec4 planes[6]) {
+    mat4 m = transpose(viewProj);  // rows of the matrix
+    for (int i = 0; i < 3; ++i) {
+        planes[i * 2] = m[3] + m[i];
+        planes[i * 2 + 1] = m[3] - m[i];
+    }
+    for (int i = 0; i < 6; ++i) planes[i] /= length(vec3(planes[i]));
+}
+
 void print(vec4 v) {
     printf("(%f, %f, %f, %f)\n", v.x, v.y, v.z, v.w);
 }
@@ -226,9 +269,11 @@ void print(mat4 m) {
     printf("[%.2f][%.2f][%.2f][%.2f]\n", m[0][3], m[1][3], m[2][3], m[3][3]);
 }
 
+#ifndef HEADLESS
 void print(aiMatrix4x4 m) {
     print(aiToGLM(&m));
 }
+#endif
 
 void print(std::vector<int> vs) {
     printf("[");
@@ -13,10 +13,14 @@
 #include <string>
 #include <vector>
 #include <random>
+#include <mutex>
+#include <algorithm>
 
 #define GLM_ENABLE_EXPERIMENTAL
+#ifndef HEADLESS
 #include <GL/glew.h>
 #include <GL/freeglut.h>
+#endif
 #include <glm/mat4x4.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/glm.hpp>
@@ -25,8 +29,10 @@
 #include <glm/gtx/norm.hpp>
 #include <glm/gtx/matrix_interpolation.hpp>
 
+#ifndef HEADLESS
 #include <assimp/scene.h>        // collects data
 #include <assimp/postprocess.h>  // various extra operations
+#endif
 
 #include "sm.h"
 
@@ -47,7 +53,7 @@ extern vec3 X;        // Value of 1 on x axis (1, 0, 0)
 extern vec3 Y;        // Value of 1 on y axis (0, 1, 0)
 extern vec3 Z;        // Value of 1 on z axis (0, 0, 1)
 extern std::random_device rand_dev;
-extern std::mt19937 mt_gen;
+extern thread_local std::mt19937 mt_gen;  // per thread, so random numbers can be drawn from the flock workers
 
 extern std::string readFile(const char* path);
 extern float wrap(float val, float min, float max);
@@ -57,9 +63,11 @@ extern float clamp(float val, float min, float max);
 extern vec3 clampV(vec3 val, vec3 min, vec3 max);
 extern float d2r(float val);
 extern float r2d(float val);
+#ifndef HEADLESS
 extern aiMatrix4x4 GLMtoAI(const mat4& mat);
 extern mat4 aiToGLM(const aiMatrix4x4* from);
 extern vec3 aiToGLM(aiVector3D* from);
+#endif
 extern std::tuple<vec3, quat, vec3, vec3, vec4> decomposeMat4(mat4& mat);
 extern vec3 getTranslation(mat4& mat);
 extern vec3 angleToVec3(float angle);
@@ -69,16 +77,21 @@ extern vec3 lerpV(vec3 a, vec3 b, float dt);
 extern float mapRange(float v, float inLow, float inHigh, float outLow, float outHigh);
 extern mat4 lookTowards(vec3 pos, vec3 to);
 extern mat4 lookTowards(vec3 pos, vec3 to, vec3 up);
+extern void frustumPlanes(const mat4& viewProj, vec4 planes[6]);
 extern void print(vec2 v);
 extern void print(vec3 v);
 extern void print(vec4 v);
 extern void print(mat4 m);
+#ifndef HEADLESS
 extern void print(aiMatrix4x4 m);
+#endif
 extern void print(std::vector<int>);
 extern void print(std::vector<float>);
 extern int compareFloat(float a, float b);
 extern int random(int lo, int hi);
 extern vec3 randomv(int lo, int hi);
+extern unsigned mortonCode(vec3 p, vec3 low, vec3 high);
+extern std::vector<unsigned> mortonOrder(const vec3* points, unsigned count, vec3 low, vec3 high);
 };  // namespace Util
 
 #endif  // UTIL_H
@@ -1,5 +1,64 @@
 #include "variantmesh.h"
 
+#include <unordered_map>
+
+// grid cells across the longest side of a mesh when clustering each level of detail. 0 keeps the full mesh
+static const int LOD_CLUSTER_RESOLUTION[VARIANT_LOD_COUNT] = {0, 24, 10};
+
+// Simplify `mesh` by vertex clustering. Vertices are snapped to a grid `resolution` cells across the mesh, each cell is
+// collapsed onto the vertex closest to the average of the cell, and triangles that collapse or repeat are dropped.
+// The result indexes the mesh's own vertices the same way `mesh.indices` does, so it shares their vertex and bone data.
+static std::vector<unsigned int> clusterIndices(const Mesh &mesh, int resolution) {
+    const std::vector<vec3> &verts = mesh.vertices;
+    if (verts.empty()) return mesh.indices;
+    vec3 lo = verts[0], hi = verts[0];
+    for (auto x : verts) {
+        lo = min(lo, x);
+        hi = max(hi, x);
+    }
+    vec3 extent = hi - lo;
+    float cellSize = std::max(std::max(extent.x, extent.y), extent.z) / resolution;
+    if (cellSize <= 0) return mesh.indices;
+    auto cellOf = [&](vec3 p) {
+        ivec3 c = ivec3((p - lo) / cellSize);
+        return (uint64_t)c.x | ((uint64_t)c.y << 21) | ((uint64_t)c.z << 42);
+    };
+
+    std::vector<unsigned int> out;
+    for (const auto &sub : mesh.meshes) {
+        // average position of each cell
+        std::unordered_map<uint64_t, vec4> sums;
+        for (unsigned int i = sub.baseIndex; i < sub.baseIndex + sub.n_Indices; ++i) {
+            vec3 p = verts[sub.baseVertex + mesh.indices[i]];
+            sums[cellOf(p)] += vec4(p, 1);
+        }
+        // the vertex nearest that average represents the cell
+        std::unordered_map<uint64_t, std::pair<unsigned int, float>> reps;
+        for (unsigned int i = sub.baseIndex; i < sub.baseIndex + sub.n_Indices; ++i) {
+            unsigned int idx = mesh.indices[i];
+            vec3 p = verts[sub.baseVertex + idx];
+            uint64_t c = cellOf(p);
+            float d = Util::sqDist(p, vec3(sums[c]) / sums[c].w);
+            auto it = reps.find(c);
+            if (it == reps.end() || d < it->second.second) reps[c] = {idx, d};
+        }
+
+        std::unordered_map<uint64_t, bool> seen;  // triangles already kept, rotated so the smallest index is first
+        for (unsigned int i = sub.baseIndex; i + 2 < sub.baseIndex + sub.n_Indices; i += 3) {
+            unsigned int t[3];
+            for (int k = 0; k < 3; ++k) t[k] = reps[cellOf(verts[sub.baseVertex + mesh.indices[i + k]])].first;
+            if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) continue;
+            int first = t[0] < t[1] ? (t[0] < t[2] ? 0 : 2) : (t[1] < t[2] ? 1 : 2);
+            unsigned int a = t[first], b = t[(first + 1) % 3], c = t[(first + 2) % 3];
+            uint64_t key = (uint64_t)a | ((uint64_t)b << 21) | ((uint64_t)c << 42);
+            if (seen[key]) continue;
+            seen[key] = true;
+            out.insert(out.end(), {a, b, c});
+        }
+    }
+    return out;
+}
+
 VariantMesh::~VariantMesh() {}
 
 bool VariantMesh::loadMeshes(std::vector<VariantInfo *> infos) {
@@ -13,7 +72,15 @@ bool VariantMesh::loadMeshes(std::vector<VariantInfo *> infos) {
         for (auto x : v->mesh->materials) {
             if (x.diffTex || x.mtlsTex) materials.push_back(x);
         }
+        v->lodBaseIndex.push_back(indices.size());
+        v->lodIndexCount.push_back(v->mesh->indices.size());
         for (auto x : v->mesh->indices) indices.push_back(x);
+        for (int l = 1; l < lodCount; ++l) {
+            std::vector<unsigned int> lod = clusterIndices(*v->mesh, LOD_CLUSTER_RESOLUTION[l]);
+            v->lodBaseIndex.push_back(indices.size());
+            v->lodIndexCount.push_back(lod.size());
+            indices.insert(indices.end(), lod.begin(), lod.end());
+        }
         for (auto x : v->depths) depths.push_back((float)x);
         for (auto x : v->mesh->vBones) vBones.push_back(x);
         for (auto x : v->mesh->boneInfos) boneInfos.push_back(x);
@@ -21,6 +88,18 @@ bool VariantMesh::loadMeshes(std::vector<VariantInfo *> infos) {
         paths.push_back(v->path);
         globalInverseMatrices.push_back(Util::aiToGLM(&v->mesh->globalInverseTrans));
         boneTransformOffsets.push_back(boneInfos.size());
+
+        // bounding sphere around the centre of the bind pose
+        vec3 lo = v->mesh->vertices.empty() ? vec3(0) : v->mesh->vertices[0], hi = lo;
+        for (auto x : v->mesh->vertices) {
+            lo = min(lo, x);
+            hi = max(hi, x);
+        }
+        vec3 centre = (lo + hi) / 2.f;
+        float radius = 0;
+        for (auto x : v->mesh->vertices) radius = std::max(radius, length(x - centre));
+        cullVariants.push_back({vec4(centre, radius * CULL_SPHERE_MARGIN), (unsigned)totalInstanceCount, v->instanceCount, {0, 0}});
+
         totalInstanceCount += v->instanceCount;
     }
     if (vBones.empty()) vBones.resize(totalInstanceCount);
@@ -41,7 +120,6 @@ void VariantMesh::populateBuffers() {
     glGenBuffers(1, &t_VBO);
     glGenBuffers(1, &d_VBO);
     glGenBuffers(1, &EBO);
-    glGenBuffers(1, &IBO);
     glGenBuffers(1, &BBO);
 
     glBindBuffer(GL_ARRAY_BUFFER, p_VBO);
@@ -62,8 +140,8 @@ void VariantMesh::populateBuffers() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, IBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(mat4) * SM::MAX_NUM_BOIDS, NULL, GL_DYNAMIC_DRAW);
+    // cpu transforms are written into the shared instance ring each draw, which rebinds them to where they went
+    glBindBuffer(GL_ARRAY_BUFFER, SM::instanceRing->buffer);
     for (unsigned int i = 0; i < 4; i++) {
         glEnableVertexAttribArray(VA_INSTANCE_LOC + i);
         glVertexAttribPointer(VA_INSTANCE_LOC + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (const void *)(i * sizeof(vec4)));
@@ -97,30 +175,75 @@ void VariantMesh::populateBuffers() {
     generateCommands();
 }
 
+// One command per variant and level of detail. Only the full detail commands have instances until the first `cull`, so the
+// instanced attributes line up for meshes drawn from the CPU.
 void VariantMesh::generateCommands() {
     glGenBuffers(1, &commandBuffer);
 
-    IndirectDrawCommand *cmds = new IndirectDrawCommand[variants.size()];
-    unsigned int baseVertex = 0, baseInstance = 0, baseIndex = 0;
+    std::vector<IndirectDrawCommand> cmds(variants.size() * lodCount);
+    cullCommands.resize(cmds.size());
+    unsigned int baseVertex = 0, baseInstance = 0;
     for (int i = 0; i < variants.size(); ++i) {
         const auto &v = variants[i];
         int vCount = v->mesh->vertices.size();  // vertices in this mesh
-        int iCount = v->mesh->indices.size();   // indices in thie mesh
+        for (int l = 0; l < lodCount; ++l) {
+            IndirectDrawCommand &cmd = cmds[i * lodCount + l];
+            cmd.indexCount = v->lodIndexCount[l];
+            cmd.instanceCount = l == 0 ? v->instanceCount : 0;  // number of instances this mesh will have
+            cmd.baseIndex = v->lodBaseIndex[l];
+            cmd.baseVertex = baseVertex;
+            cmd.baseInstance = baseInstance;  // index to begin new set of mesh instances
 
-        cmds[i].indexCount = iCount;
-        cmds[i].instanceCount = v->instanceCount;  // number of instances this mesh will have
-        cmds[i].baseIndex = baseIndex;
-        cmds[i].baseVertex = baseVertex;
-        cmds[i].baseInstance = baseInstance;  // index to begin new set of mesh instances
+            // after culling, each lod has its own range of visible instance ids, big enough for all of the variant's instances
+            cullCommands[i * lodCount + l] = cmd;
+            cullCommands[i * lodCount + l].instanceCount = 0;
+            cullCommands[i * lodCount + l].baseInstance = baseInstance * lodCount + l * v->instanceCount;
+        }
 
         baseVertex += vCount;
-        baseIndex += iCount;
         baseInstance += v->instanceCount;
     }
 
     // send command buffers to gpu
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
-    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectDrawCommand) * variants.size(), &cmds[0], GL_DYNAMIC_DRAW);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectDrawCommand) * cmds.size(), cmds.data(), GL_DYNAMIC_DRAW);
+
+    // every instance is visible at full detail until the first cull
+    std::vector<unsigned int> ids(std::max(totalInstanceCount * lodCount, 1));
+    for (int i = 0; i < totalInstanceCount; ++i) ids[i] = i;
+    glCreateBuffers(1, &VIBO);
+    glCreateBuffers(1, &CVBO);
+    glNamedBufferStorage(VIBO, ids.size() * sizeof(unsigned int), ids.data(), 0);
+    glNamedBufferStorage(CVBO, cullVariants.size() * sizeof(CullVariant), cullVariants.data(), 0);
+}
+
+// Rebuild the draw commands from the instance transforms bound for drawing (see Flock::show). With `frustum` on, only the
+// instances whose bounding spheres are inside the view frustum and closer than `maxDistance` to `viewPos` are kept. With
+// `meshLOD` on, each one is drawn at the level of detail for its size on screen (see `lodSizes`). `render()` then only
+// draws what was kept.
+void VariantMesh::cull(const mat4 &view, const mat4 &proj, vec3 viewPos, float maxDistance, float transformAlpha, bool frustum, bool meshLOD) {
+    // instance counts are rebuilt by the shader
+    glNamedBufferSubData(commandBuffer, 0, cullCommands.size() * sizeof(IndirectDrawCommand), cullCommands.data());
+
+    vec4 planes[6];
+    Util::frustumPlanes(proj * view, planes);
+    cullShader->use();
+    cullShader->setBool("useCulling", frustum);
+    cullShader->setInt("totalInstances", totalInstanceCount);
+    cullShader->setInt("variantCount", variants.size());
+    cullShader->setInt("lodCount", meshLOD ? lodCount : 1);
+    cullShader->setInt("commandsPerVariant", lodCount);
+    cullShader->setVec2("lodSizes", lodSizes);
+    cullShader->setFloat("projScale", proj[1][1] / 2);  // screen heights per unit of size over distance
+    for (int i = 0; i < 6; ++i) cullShader->setVec4("frustumPlanes[" + std::to_string(i) + "]", planes[i]);
+    cullShader->setVec3("viewPos", viewPos);
+    cullShader->setFloat("maxDistance", maxDistance);
+    cullShader->setFloat("transformAlpha", transformAlpha);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, VIBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, CVBO);
+    glDispatchCompute(totalInstanceCount / 1024 + 1, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);  // the draw reads the counts and the ids
 }
 
 // Bind up to 12 diffuse and metalness textures
@@ -150,13 +273,21 @@ void VariantMesh::unloadMaterials() {
 
 // Update and render all animations for each variant
 void VariantMesh::render(const mat4 *instance_trans_matrix) {
+    // skinned variants on the gpu path read their transforms straight from boids.comp's output instead
+    bool cpuTransforms = type == STATIC;
+#ifdef TREE
+    cpuTransforms = true;
+#endif
+    GLintptr offset = 0;
+    if (cpuTransforms) {
+        offset = SM::instanceRing->upload(instance_trans_matrix, sizeof(mat4) * totalInstanceCount);
+        if (offset < 0) return;  // too many instances for the ring
+    }
+
     glBindVertexArray(VAO);
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);  // rebind command buffer
+    if (cpuTransforms) SM::instanceRing->bindAttribute(VA_INSTANCE_LOC, 4, offset, sizeof(mat4));
     if (type == SKINNED) {
-#ifdef TREE
-        glBindBuffer(GL_ARRAY_BUFFER, IBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(mat4) * totalInstanceCount, &instance_trans_matrix[0]);
-#endif
         // update animations
         animShader->use();
         animShader->setFloat("timeSinceApplicationStarted", SM::getGlobalTime());
@@ -165,20 +296,18 @@ void VariantMesh::render(const mat4 *instance_trans_matrix) {
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, BOBO);
         glDispatchCompute((int)ceil(boneInfos.size() / 32.f), 1, 1);  // declare work group sizes and run compute shader
         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);               // wait for all threads to be finished
-    } else if (type == STATIC) {
-        glBindBuffer(GL_ARRAY_BUFFER, IBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(mat4) * totalInstanceCount, &instance_trans_matrix[0]);
     }
 
     loadMaterials();
 
     shader->use();
+    shader->setInt("drawsPerVariant", lodCount);
     glMultiDrawElementsIndirect(
-        GL_TRIANGLES,     // draw triangles
-        GL_UNSIGNED_INT,  // data type in indices
-        (const void *)0,  // no offset; commands already bound to buffer
-        variants.size(),  // number of variants
-        0                 // no stride
+        GL_TRIANGLES,                // draw triangles
+        GL_UNSIGNED_INT,             // data type in indices
+        (const void *)0,             // no offset; commands already bound to buffer
+        variants.size() * lodCount,  // number of variants and their levels of detail
+        0                            // no stride
     );
 
     unloadMaterials();
@@ -194,8 +323,11 @@ void VariantMesh::render(mat4 mm) {
 void VariantMesh::render() {
     glBindVertexArray(VAO);
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);  // rebind command buffer
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, VIBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, d_VBO);
 
     // update animations
+    SM::profiler->begin("anim.comp");
     animShader->use();
     animShader->setFloat("timeSinceApplicationStarted", SM::getGlobalTime());
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ABBO);
@@ -204,18 +336,21 @@ void VariantMesh::render() {
     glDispatchCompute((int)ceil(boneInfos.size() / 32.f), 1, 1);  // declare work group sizes and run compute shader
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);               // wait for all threads to be finished
 
+    SM::profiler->begin("Flock Draw");
     loadMaterials();
 
     shader->use();
+    shader->setInt("drawsPerVariant", lodCount);
     glMultiDrawElementsIndirect(
-        GL_TRIANGLES,     // draw triangles
-        GL_UNSIGNED_INT,  // data type in indices
-        (const void *)0,  // no offset; commands already bound to buffer
-        variants.size(),  // number of variants
-        0                 // no stride
+        GL_TRIANGLES,                // draw triangles
+        GL_UNSIGNED_INT,             // data type in indices
+        (const void *)0,             // no offset; commands already bound to buffer
+        variants.size() * lodCount,  // number of variants and their levels of detail
+        0                            // no stride
     );
 
     unloadMaterials();
     glUseProgram(0);
     glBindVertexArray(0);  // prevent VAO from being changed externally
+    SM::profiler->end();
 }
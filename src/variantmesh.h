@@ -11,6 +11,9 @@
 #include "bonemesh.h"
 #include "shader.h"
 
+#define CULL_SPHERE_MARGIN 1.5f  // bounding spheres are made this much bigger than the bind pose, so animation stays inside
+#define VARIANT_LOD_COUNT 3      // levels of detail of each skinned variant, including the full mesh
+
 enum VariantType {
     STATIC,
     SKINNED
@@ -28,6 +31,14 @@ class VariantMesh : public Mesh {
         unsigned int baseInstance;
     };
 
+    // what cull.comp needs to know about each variant
+    struct CullVariant {
+        vec4 sphere;  // bounding sphere in model space. xyz is the centre, w the radius
+        unsigned int firstInstance;
+        unsigned int instanceCount;
+        unsigned int padding[2];
+    };
+
     struct VariantInfo {
         VariantInfo(std::string parentName_,
                     std::string path_,
@@ -59,6 +70,8 @@ class VariantMesh : public Mesh {
         unsigned int textureAtlasSize;
         unsigned int textureAtlasTileCount;
         std::vector<unsigned int> depths;
+        std::vector<unsigned int> lodBaseIndex;   // first index of each level of detail in the shared index buffer
+        std::vector<unsigned int> lodIndexCount;  // number of indices in each level of detail
         Mesh* mesh;
         VariantType type;
     };
@@ -78,7 +91,9 @@ class VariantMesh : public Mesh {
         name = nm;
         shader = s;
         type = type_;
+        lodCount = type == SKINNED ? VARIANT_LOD_COUNT : 1;
         animShader = new Shader("anim shader", PROJDIR "Shaders/anim.comp");
+        cullShader = new Shader("cull shader", PROJDIR "Shaders/cull.comp");
         for (const auto& [path_, instanceCount_, textureAtlasSize_, textureAtlasTileCount_, depths_] : variants_) {
             VariantInfo* vi = new VariantInfo(name, path_, type, instanceCount_, textureAtlasSize_, textureAtlasTileCount_, depths_);
             variants.push_back(vi);
@@ -97,6 +112,7 @@ class VariantMesh : public Mesh {
     void unloadMaterials();
     void generateCommands();
     void populateBuffers();
+    void cull(const mat4& view, const mat4& proj, vec3 viewPos, float maxDistance, float transformAlpha, bool frustum, bool meshLOD);
     void render(const mat4*);
     void render(mat4);
     void render();
@@ -119,13 +135,20 @@ class VariantMesh : public Mesh {
     unsigned int BIBO;                        // bone info ssbo
     unsigned int BOBO;                        // bone offset ssbo
     unsigned int commandBuffer;               // draw command buffer object (compute shader)
+    unsigned int VIBO;                        // visible instance ids, packed per variant by `cull`
+    unsigned int CVBO;                        // cull variant ssbo
     int totalInstanceCount = 0;               // number of instances across all variants
+    int lodCount = 1;                         // levels of detail per variant. each gets its own draw command
+    vec2 lodSizes = vec2(.06f, .02f);         // on screen size (fraction of the screen height) below which instances drop to lod 1 and 2
     std::vector<float> depths;                // texture depths for each variant
     std::vector<int> boneTransformOffsets;    // number of bones in each variant
     std::vector<mat4> globalInverseMatrices;  // global inverse matrix for each variant
     std::vector<std::string> paths;           // paths of variant mesh files
     std::vector<VariantInfo*> variants;       // variant meshes held in this object
+    std::vector<CullVariant> cullVariants;    // bounds and instance range of each variant
+    std::vector<IndirectDrawCommand> cullCommands;  // draw commands with no instances, and room in VIBO for every instance at each lod
     Shader* animShader;
+    Shader* cullShader;
     VariantType type;
 };
 